@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoints for the Jinglitai JLT4013A LCD Panel driver.
+ *
+ * Copyright (C) Rui Oliveira 2022
+ * Copyright (C) Oleg Belousov 2022
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM jlt4013a
+
+#if !defined(_JLT4013A_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _JLT4013A_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/version.h>
+
+TRACE_EVENT(jlt4013a_cmd,
+	TP_PROTO(u8 cmd, const u8 *data, size_t len),
+	TP_ARGS(cmd, data, len),
+
+	TP_STRUCT__entry(
+		__field(u8, cmd)
+		__dynamic_array(u8, data, len)
+	),
+
+	TP_fast_assign(
+		__entry->cmd = cmd;
+		memcpy(__get_dynamic_array(data), data, len);
+	),
+
+	TP_printk("cmd=%02x len=%u data=%s", __entry->cmd,
+		  __get_dynamic_array_len(data),
+		  __print_hex(__get_dynamic_array(data),
+			      __get_dynamic_array_len(data)))
+);
+
+DECLARE_EVENT_CLASS(jlt4013a_phase,
+	TP_PROTO(const char *phase),
+	TP_ARGS(phase),
+
+	TP_STRUCT__entry(
+		__string(phase, phase)
+	),
+
+	TP_fast_assign(
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,10,0)
+		__assign_str(phase);
+#else
+		__assign_str(phase, phase);
+#endif
+	),
+
+	TP_printk("%s", __get_str(phase))
+);
+
+DEFINE_EVENT(jlt4013a_phase, jlt4013a_phase_begin,
+	TP_PROTO(const char *phase),
+	TP_ARGS(phase)
+);
+
+DEFINE_EVENT(jlt4013a_phase, jlt4013a_phase_end,
+	TP_PROTO(const char *phase),
+	TP_ARGS(phase)
+);
+
+#endif /* _JLT4013A_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE jlt4013a_trace
+#include <trace/define_trace.h>
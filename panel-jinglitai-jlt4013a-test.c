@@ -0,0 +1,571 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests for the Jinglitai JLT4013A LCD Panel driver.
+ *
+ * Built into the module with "make KUNIT=1", as they need the driver's static
+ * functions, and run when it is loaded on a kernel with CONFIG_KUNIT. The
+ * panel sits on a fake SPI controller and its DCX line on a fake GPIO chip,
+ * both of which record what the panel would have received.
+ *
+ * Copyright (C) Rui Oliveira 2022
+ * Copyright (C) Oleg Belousov 2022
+ */
+
+#include <kunit/test.h>
+#include <linux/device.h>
+#include <linux/gpio/driver.h>
+#include <linux/gpio/machine.h>
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,2,0)
+#error "The JLT4013A KUnit tests need Linux 6.2 or later"
+#endif
+
+#define JLT4013A_TEST_WORDS 512
+
+/* Everything the panel receives, as 9-bit words with D/C in bit 8 */
+struct jlt4013a_test {
+	struct device *dev;
+	struct spi_controller *ctlr;
+	struct spi_device *spi;
+	struct gpio_chip chip;
+	struct gpio_desc *dcx_desc;
+	bool gpio_added;
+	int dcx;
+	bool use_dcx;
+	u16 words[JLT4013A_TEST_WORDS];
+	unsigned int len;
+	bool overflow;
+};
+
+static void jlt4013a_test_log(struct jlt4013a_test *priv, u16 word)
+{
+	if (priv->len == JLT4013A_TEST_WORDS) {
+		priv->overflow = true;
+		return;
+	}
+
+	priv->words[priv->len++] = word;
+}
+
+/* Unpacks a packed 9-bit stream, dropping the NOPs it was padded with */
+static void jlt4013a_test_unpack9(struct jlt4013a_test *priv, const u8 *buf,
+				  unsigned int len)
+{
+	unsigned int i, bits = 0;
+	u32 acc = 0;
+	u16 word;
+
+	for (i = 0; i < len; i++) {
+		acc = (acc << 8) | buf[i];
+		bits += 8;
+		if (bits < 9)
+			continue;
+
+		bits -= 9;
+		word = (acc >> bits) & 0x1ff;
+		acc &= BIT(bits) - 1;
+		if (word)
+			jlt4013a_test_log(priv, word);
+	}
+}
+
+static int jlt4013a_test_transfer_one(struct spi_controller *ctlr,
+				      struct spi_device *spi,
+				      struct spi_transfer *xfer)
+{
+	struct jlt4013a_test *priv =
+		*(struct jlt4013a_test **)spi_controller_get_devdata(ctlr);
+	const u16 *words = xfer->tx_buf;
+	const u8 *bytes = xfer->tx_buf;
+	unsigned int i;
+
+	if (xfer->rx_buf)
+		memset(xfer->rx_buf, 0, xfer->len);
+
+	if (!xfer->tx_buf)
+		return 0;
+
+	if (xfer->bits_per_word == 9) {
+		for (i = 0; i < xfer->len / sizeof(u16); i++)
+			jlt4013a_test_log(priv, words[i] & 0x1ff);
+	} else if (priv->use_dcx) {
+		for (i = 0; i < xfer->len; i++)
+			jlt4013a_test_log(priv, (priv->dcx ? 0x100 : 0) |
+							bytes[i]);
+	} else {
+		jlt4013a_test_unpack9(priv, bytes, xfer->len);
+	}
+
+	return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,17,0)
+static int jlt4013a_test_gpio_set(struct gpio_chip *gc, unsigned int offset,
+				  int value)
+{
+	struct jlt4013a_test *priv = gpiochip_get_data(gc);
+
+	priv->dcx = value;
+	return 0;
+}
+#else
+static void jlt4013a_test_gpio_set(struct gpio_chip *gc, unsigned int offset,
+				   int value)
+{
+	struct jlt4013a_test *priv = gpiochip_get_data(gc);
+
+	priv->dcx = value;
+}
+#endif
+
+static int jlt4013a_test_gpio_direction_output(struct gpio_chip *gc,
+					       unsigned int offset, int value)
+{
+	struct jlt4013a_test *priv = gpiochip_get_data(gc);
+
+	priv->dcx = value;
+	return 0;
+}
+
+static int jlt4013a_test_init(struct kunit *test)
+{
+	struct jlt4013a_test *priv;
+
+	priv = kunit_kzalloc(test, sizeof(*priv), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, priv);
+
+	priv->dev = root_device_register("jlt4013a-test");
+	KUNIT_ASSERT_FALSE(test, IS_ERR(priv->dev));
+
+	test->priv = priv;
+	return 0;
+}
+
+static void jlt4013a_test_exit(struct kunit *test)
+{
+	struct jlt4013a_test *priv = test->priv;
+
+	if (priv->dcx_desc)
+		gpiochip_free_own_desc(priv->dcx_desc);
+	if (priv->gpio_added)
+		gpiochip_remove(&priv->chip);
+	if (priv->spi)
+		spi_dev_put(priv->spi);
+	if (priv->ctlr)
+		spi_unregister_controller(priv->ctlr);
+
+	root_device_unregister(priv->dev);
+}
+
+static void jlt4013a_test_add_spi(struct kunit *test, bool bpw9)
+{
+	struct jlt4013a_test *priv = test->priv;
+	struct spi_controller *ctlr;
+	int ret;
+
+	ctlr = spi_alloc_host(priv->dev, sizeof(priv));
+	KUNIT_ASSERT_NOT_NULL(test, ctlr);
+
+	*(struct jlt4013a_test **)spi_controller_get_devdata(ctlr) = priv;
+	ctlr->bus_num = -1;
+	ctlr->num_chipselect = 1;
+	ctlr->bits_per_word_mask = SPI_BPW_MASK(8);
+	if (bpw9)
+		ctlr->bits_per_word_mask |= SPI_BPW_MASK(9);
+	ctlr->transfer_one = jlt4013a_test_transfer_one;
+
+	ret = spi_register_controller(ctlr);
+	if (ret)
+		spi_controller_put(ctlr);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+	priv->ctlr = ctlr;
+
+	priv->spi = spi_alloc_device(ctlr);
+	KUNIT_ASSERT_NOT_NULL(test, priv->spi);
+
+	strscpy(priv->spi->modalias, "jlt4013a-test",
+		sizeof(priv->spi->modalias));
+	priv->spi->max_speed_hz = 1000000;
+	priv->spi->bits_per_word = 8;
+	KUNIT_ASSERT_EQ(test, spi_setup(priv->spi), 0);
+}
+
+static void jlt4013a_test_add_dcx(struct kunit *test)
+{
+	struct jlt4013a_test *priv = test->priv;
+	struct gpio_chip *chip = &priv->chip;
+	struct gpio_desc *desc;
+
+	chip->label = "jlt4013a-test";
+	chip->parent = priv->dev;
+	chip->owner = THIS_MODULE;
+	chip->base = -1;
+	chip->ngpio = 1;
+	chip->set = jlt4013a_test_gpio_set;
+	chip->direction_output = jlt4013a_test_gpio_direction_output;
+
+	KUNIT_ASSERT_EQ(test, gpiochip_add_data(chip, priv), 0);
+	priv->gpio_added = true;
+
+	desc = gpiochip_request_own_desc(chip, 0, "dcx",
+					 GPIO_LOOKUP_FLAGS_DEFAULT,
+					 GPIOD_OUT_LOW);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(desc));
+	priv->dcx_desc = desc;
+	priv->use_dcx = true;
+}
+
+/* What probe sets up, minus the device tree, firmware and runtime PM */
+static struct jlt4013a *jlt4013a_test_ctx(struct kunit *test,
+					  enum st7701s_bus bus)
+{
+	struct jlt4013a_test *priv = test->priv;
+	struct jlt4013a *ctx;
+
+	jlt4013a_test_add_spi(test, bus == ST7701S_BUS_9BIT);
+	if (bus == ST7701S_BUS_DCX)
+		jlt4013a_test_add_dcx(test);
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, ctx);
+
+	ctx->spi = priv->spi;
+	ctx->desc = &jlt4013a_desc;
+	ctx->bus = bus;
+	ctx->dcx = priv->dcx_desc;
+
+	if (bus != ST7701S_BUS_DCX) {
+		ctx->pipe = kunit_kzalloc(test, sizeof(*ctx->pipe),
+					  GFP_KERNEL);
+		KUNIT_ASSERT_NOT_NULL(test, ctx->pipe);
+		init_completion(&ctx->pipe->done);
+	}
+
+	ctx->panel.dev = priv->dev;
+
+	ctx->supply = devm_regulator_get(priv->dev, "power");
+	KUNIT_ASSERT_FALSE(test, IS_ERR(ctx->supply));
+
+	ctx->seq = ctx->desc->seq;
+	ctx->seq_len = ctx->desc->seq_len;
+	ctx->format = &jlt4013a_formats[ARRAY_SIZE(jlt4013a_formats) - 1];
+	KUNIT_ASSERT_EQ(test, jlt4013a_build_profile(ctx), 0);
+
+	mutex_init(&ctx->lock);
+	st7701s_shadow_reset(ctx, ST7701S_BANK_UNKNOWN);
+
+	ctx->regmap = devm_regmap_init(priv->dev, &jlt4013a_regmap_bus, ctx,
+				       &jlt4013a_regmap_config);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(ctx->regmap));
+	regcache_cache_only(ctx->regmap, true);
+
+	return ctx;
+}
+
+/* The built-in sequence from SLPOUT to DISPON, with the default profile */
+static const u16 jlt4013a_test_stream[] = {
+	0x011,
+	0x036, 0x100,
+	0x0FF, 0x177, 0x101, 0x100, 0x100, 0x110,
+	0x0C7, 0x100,
+	0x0FF, 0x177, 0x101, 0x100, 0x100, 0x100,
+	0x0FF, 0x177, 0x101, 0x100, 0x100, 0x110,
+	0x0C1, 0x111, 0x102,
+	0x0FF, 0x177, 0x101, 0x100, 0x100, 0x100,
+	0x0FF, 0x177, 0x101, 0x100, 0x100, 0x110,
+	0x0C2, 0x131, 0x103,
+	0x0CC, 0x110,
+	0x0B0, 0x140, 0x101, 0x146, 0x10D, 0x113, 0x109, 0x105, 0x109, 0x109,
+		0x11B, 0x107, 0x115, 0x112, 0x14C, 0x110, 0x1C8,
+	0x0B1, 0x140, 0x102, 0x186, 0x10D, 0x113, 0x109, 0x105, 0x109, 0x109,
+		0x11F, 0x107, 0x115, 0x112, 0x115, 0x119, 0x108,
+	0x0FF, 0x177, 0x101, 0x100, 0x100, 0x111,
+	0x0B0, 0x150,
+	0x0B1, 0x168,
+	0x0B2, 0x107,
+	0x0B3, 0x180,
+	0x0B5, 0x147,
+	0x0B7, 0x185,
+	0x0B8, 0x121,
+	0x0B9, 0x110,
+	0x0C1, 0x121, 0x136,
+	0x0C2, 0x178,
+	0x0E0, 0x100, 0x100, 0x102,
+	0x0E1, 0x108, 0x100, 0x10A, 0x100, 0x107, 0x100, 0x109, 0x100, 0x100,
+		0x133, 0x133,
+	0x0E2, 0x100, 0x100, 0x100, 0x100, 0x100, 0x100, 0x100, 0x100, 0x100,
+		0x100, 0x100, 0x100, 0x100,
+	0x0E3, 0x100, 0x100, 0x133, 0x133,
+	0x0E4, 0x144, 0x144,
+	0x0E5, 0x10E, 0x12D, 0x1A0, 0x1A0, 0x110, 0x12D, 0x1A0, 0x1A0, 0x10A,
+		0x12D, 0x1A0, 0x1A0, 0x10C, 0x12D, 0x1A0, 0x1A0,
+	0x0E6, 0x100, 0x100, 0x133, 0x133,
+	0x0E7, 0x144, 0x144,
+	0x0E8, 0x10D, 0x12D, 0x1A0, 0x1A0, 0x10F, 0x12D, 0x1A0, 0x1A0, 0x109,
+		0x12D, 0x1A0, 0x1A0, 0x10B, 0x12D, 0x1A0, 0x1A0,
+	0x0EB, 0x102, 0x101, 0x1E4, 0x1E4, 0x144, 0x100, 0x140,
+	0x0EC, 0x102, 0x101,
+	0x0ED, 0x1AB, 0x189, 0x176, 0x154, 0x101, 0x1FF, 0x1FF, 0x1FF, 0x1FF,
+		0x1FF, 0x1FF, 0x110, 0x145, 0x167, 0x198, 0x1BA,
+	0x0FF, 0x177, 0x101, 0x100, 0x100, 0x100,
+	0x03A, 0x177,
+	0x029,
+};
+
+static void jlt4013a_test_stream_bus(struct kunit *test, enum st7701s_bus bus)
+{
+	struct jlt4013a_test *priv = test->priv;
+	struct jlt4013a *ctx = jlt4013a_test_ctx(test, bus);
+	struct jlt4013a_spi_stats stats;
+	unsigned int i;
+	int ret;
+
+	mutex_lock(&ctx->lock);
+	ret = jlt4013a_bring_up(ctx);
+	stats = ctx->stats;
+	if (!ret)
+		ret = jlt4013a_display_on(ctx);
+	jlt4013a_power_off(ctx);
+	mutex_unlock(&ctx->lock);
+
+	KUNIT_ASSERT_EQ(test, ret, 0);
+	KUNIT_ASSERT_FALSE(test, priv->overflow);
+	KUNIT_ASSERT_EQ(test, priv->len, ARRAY_SIZE(jlt4013a_test_stream));
+
+	for (i = 0; i < priv->len; i++)
+		KUNIT_ASSERT_EQ_MSG(test, priv->words[i],
+				    jlt4013a_test_stream[i], "word %u", i);
+
+	kunit_info(test,
+		   "%s: %u messages, %u bytes, %u DCX writes, %u delays\n",
+		   st7701s_bus_names[bus], stats.messages, stats.bytes,
+		   stats.dcx_writes, stats.delays);
+
+	if (bus == ST7701S_BUS_DCX) {
+		KUNIT_EXPECT_GT(test, stats.dcx_writes, 0);
+		return;
+	}
+
+	KUNIT_EXPECT_EQ(test, stats.dcx_writes, 0);
+
+	/* Everything up to the DISPON, as 16-bit words */
+	if (bus == ST7701S_BUS_9BIT)
+		KUNIT_EXPECT_EQ(test, stats.bytes,
+				(ARRAY_SIZE(jlt4013a_test_stream) - 1) *
+					sizeof(u16));
+
+	/* Pipelined, a message ends at each delay and one more at the end */
+	if (pipelined_init)
+		KUNIT_EXPECT_EQ(test, stats.messages, stats.delays + 1);
+}
+
+static void jlt4013a_test_stream_dcx(struct kunit *test)
+{
+	jlt4013a_test_stream_bus(test, ST7701S_BUS_DCX);
+}
+
+static void jlt4013a_test_stream_9bit(struct kunit *test)
+{
+	jlt4013a_test_stream_bus(test, ST7701S_BUS_9BIT);
+}
+
+static void jlt4013a_test_stream_9bit_packed(struct kunit *test)
+{
+	jlt4013a_test_stream_bus(test, ST7701S_BUS_9BIT_PACKED);
+}
+
+struct jlt4013a_pack9_case {
+	const char *name;
+	const u16 *words;
+	unsigned int nwords;
+	const u8 *bytes;
+	size_t nbytes;
+};
+
+#define JLT4013A_PACK9_CASE(_name, _words, _bytes)                             \
+	{                                                                      \
+		.name = (_name), .words = (_words),                            \
+		.nwords = ARRAY_SIZE(_words), .bytes = (_bytes),               \
+		.nbytes = ARRAY_SIZE(_bytes),                                  \
+	}
+
+static const u16 jlt4013a_pack9_one[] = { 0x011 };
+static const u8 jlt4013a_pack9_one_bytes[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11,
+};
+
+static const u16 jlt4013a_pack9_two[] = { 0x029, 0x1aa };
+static const u8 jlt4013a_pack9_two_bytes[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x53, 0xaa,
+};
+
+static const u16 jlt4013a_pack9_eight[] = {
+	0x0ff, 0x177, 0x101, 0x100, 0x100, 0x110, 0x0c1, 0x111,
+};
+static const u8 jlt4013a_pack9_eight_bytes[] = {
+	0x7f, 0xdd, 0xe0, 0x30, 0x08, 0x04, 0x41, 0x83, 0x11,
+};
+
+static const u16 jlt4013a_pack9_nine[] = {
+	0x100, 0x101, 0x102, 0x103, 0x104, 0x105, 0x106, 0x107, 0x108,
+};
+static const u8 jlt4013a_pack9_nine_bytes[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+	0x80, 0xc0, 0xa0, 0x70, 0x48, 0x2c, 0x1a, 0x0f, 0x08,
+};
+
+static const struct jlt4013a_pack9_case jlt4013a_pack9_cases[] = {
+	JLT4013A_PACK9_CASE("one word", jlt4013a_pack9_one,
+			    jlt4013a_pack9_one_bytes),
+	JLT4013A_PACK9_CASE("command and data", jlt4013a_pack9_two,
+			    jlt4013a_pack9_two_bytes),
+	JLT4013A_PACK9_CASE("eight words", jlt4013a_pack9_eight,
+			    jlt4013a_pack9_eight_bytes),
+	JLT4013A_PACK9_CASE("nine words", jlt4013a_pack9_nine,
+			    jlt4013a_pack9_nine_bytes),
+};
+
+static void jlt4013a_pack9_desc(const struct jlt4013a_pack9_case *t,
+				char *desc)
+{
+	strscpy(desc, t->name, KUNIT_PARAM_DESC_SIZE);
+}
+
+KUNIT_ARRAY_PARAM(jlt4013a_pack9, jlt4013a_pack9_cases, jlt4013a_pack9_desc);
+
+static void jlt4013a_test_pack9(struct kunit *test)
+{
+	const struct jlt4013a_pack9_case *t = test->param_value;
+	u8 buf[32];
+	size_t len;
+	unsigned int i;
+
+	len = st7701s_pack9(buf, t->words, t->nwords);
+
+	KUNIT_ASSERT_EQ(test, len, t->nbytes);
+	for (i = 0; i < len; i++)
+		KUNIT_EXPECT_EQ_MSG(test, buf[i], t->bytes[i], "byte %u", i);
+}
+
+struct jlt4013a_fw_case {
+	const char *name;
+	const u8 *data;
+	size_t size;
+	int ret;
+};
+
+#define JLT4013A_FW_CASE(_name, _data, _ret)                                   \
+	{                                                                      \
+		.name = (_name), .data = (_data), .size = sizeof(_data),       \
+		.ret = (_ret),                                                 \
+	}
+
+#define JLT4013A_FW_HDR(_version, _count)                                      \
+	'J', 'L', 'T', 'S', (_version), 0x00, (_count), 0x00
+
+static const u8 jlt4013a_fw_valid[] = {
+	JLT4013A_FW_HDR(1, 2),
+	0x11, 0x00, 0x78, 0x00,
+	0x3a, 0x01, 0x00, 0x00, 0x77,
+};
+
+static const u8 jlt4013a_fw_short[] = { 'J', 'L', 'T', 'S', 0x01 };
+
+static const u8 jlt4013a_fw_magic[] = {
+	'J', 'L', 'T', 'X', 0x01, 0x00, 0x01, 0x00,
+	0x29, 0x00, 0x00, 0x00,
+};
+
+static const u8 jlt4013a_fw_version[] = {
+	JLT4013A_FW_HDR(2, 1),
+	0x29, 0x00, 0x00, 0x00,
+};
+
+static const u8 jlt4013a_fw_empty[] = { JLT4013A_FW_HDR(1, 0) };
+
+static const u8 jlt4013a_fw_truncated[] = {
+	JLT4013A_FW_HDR(1, 2),
+	0x29, 0x00, 0x00, 0x00,
+};
+
+static const u8 jlt4013a_fw_overcount[] = {
+	'J', 'L', 'T', 'S', 0x01, 0x00, 0xff, 0xff,
+	0x29, 0x00, 0x00, 0x00,
+};
+
+static const u8 jlt4013a_fw_short_params[] = {
+	JLT4013A_FW_HDR(1, 1),
+	0x3a, 0x02, 0x00, 0x00, 0x77,
+};
+
+static const u8 jlt4013a_fw_long_params[] = {
+	JLT4013A_FW_HDR(1, 1),
+	0xe5, ST7701S_MAX_PARAMS + 1, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const u8 jlt4013a_fw_trailing[] = {
+	JLT4013A_FW_HDR(1, 1),
+	0x29, 0x00, 0x00, 0x00,
+	0x00,
+};
+
+static const struct jlt4013a_fw_case jlt4013a_fw_cases[] = {
+	JLT4013A_FW_CASE("valid", jlt4013a_fw_valid, 0),
+	JLT4013A_FW_CASE("short header", jlt4013a_fw_short, -EINVAL),
+	JLT4013A_FW_CASE("bad magic", jlt4013a_fw_magic, -EINVAL),
+	JLT4013A_FW_CASE("bad version", jlt4013a_fw_version, -EINVAL),
+	JLT4013A_FW_CASE("no commands", jlt4013a_fw_empty, -EINVAL),
+	JLT4013A_FW_CASE("missing command", jlt4013a_fw_truncated, -EINVAL),
+	JLT4013A_FW_CASE("count beyond file", jlt4013a_fw_overcount, -EINVAL),
+	JLT4013A_FW_CASE("missing parameter", jlt4013a_fw_short_params,
+			 -EINVAL),
+	JLT4013A_FW_CASE("too many parameters", jlt4013a_fw_long_params,
+			 -EINVAL),
+	JLT4013A_FW_CASE("trailing bytes", jlt4013a_fw_trailing, -EINVAL),
+};
+
+static void jlt4013a_fw_desc(const struct jlt4013a_fw_case *t, char *desc)
+{
+	strscpy(desc, t->name, KUNIT_PARAM_DESC_SIZE);
+}
+
+KUNIT_ARRAY_PARAM(jlt4013a_fw, jlt4013a_fw_cases, jlt4013a_fw_desc);
+
+static void jlt4013a_test_firmware(struct kunit *test)
+{
+	const struct jlt4013a_fw_case *t = test->param_value;
+	struct jlt4013a_test *priv = test->priv;
+	struct firmware fw = { .data = t->data, .size = t->size };
+	struct st7701s_seq seq = {};
+
+	KUNIT_ASSERT_EQ(test, jlt4013a_parse_firmware(priv->dev, &fw, &seq),
+			t->ret);
+	if (t->ret)
+		return;
+
+	KUNIT_ASSERT_EQ(test, seq.len, 2);
+	KUNIT_EXPECT_EQ(test, seq.cmds[0].cmd, ST7701S_SLPOUT);
+	KUNIT_EXPECT_EQ(test, seq.cmds[0].delay_ms, 120);
+	KUNIT_EXPECT_EQ(test, seq.cmds[1].cmd, ST7701S_COLMOD);
+	KUNIT_EXPECT_EQ(test, seq.cmds[1].len, 1);
+	KUNIT_EXPECT_EQ(test, seq.cmds[1].data[0], 0x77);
+}
+
+static struct kunit_case jlt4013a_test_cases[] = {
+	KUNIT_CASE_PARAM(jlt4013a_test_pack9, jlt4013a_pack9_gen_params),
+	KUNIT_CASE_PARAM(jlt4013a_test_firmware, jlt4013a_fw_gen_params),
+	KUNIT_CASE(jlt4013a_test_stream_dcx),
+	KUNIT_CASE(jlt4013a_test_stream_9bit),
+	KUNIT_CASE(jlt4013a_test_stream_9bit_packed),
+	{}
+};
+
+static struct kunit_suite jlt4013a_test_suite = {
+	.name = "jlt4013a",
+	.init = jlt4013a_test_init,
+	.exit = jlt4013a_test_exit,
+	.test_cases = jlt4013a_test_cases,
+};
+kunit_test_suite(jlt4013a_test_suite);
@@ -6,27 +6,65 @@
  * Copyright (C) Oleg Belousov 2022
  */
 
+#include <linux/cache.h>
+#include <linux/atomic.h>
+#include <linux/bitfield.h>
+#include <linux/bitmap.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/firmware.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/pm_runtime.h>
 #include <linux/kernel.h>
 #include <linux/mod_devicetable.h>
+#include <linux/property.h>
+#include <linux/regmap.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 #include <drm/drm_panel.h>
 #include <drm/drm_modes.h>
 #include <drm/drm_device.h>
 #include <drm/drm_connector.h>
+#include <drm/drm_crtc.h>
 #include <linux/spi/spi.h>
 #include <linux/regulator/consumer.h>
 #include <linux/gpio/consumer.h>
 #include <linux/media-bus-format.h>
 #include <linux/version.h>
+#include <linux/workqueue.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,12,0)
+#include <linux/unaligned.h>
+#else
+#include <asm/unaligned.h>
+#endif
+
+#define CREATE_TRACE_POINTS
+#include "jlt4013a_trace.h"
 
 #define ST7701S_SWRESET 0x01
+#define ST7701S_RDDPM 0x0A
+#define ST7701S_SLPIN 0x10
 #define ST7701S_SLPOUT 0x11
 #define ST7701S_DISPOFF 0x28
 #define ST7701S_DISPON 0x29
+#define ST7701S_MADCTL 0x36
 #define ST7701S_COLMOD 0x3A
 
+#define ST7701S_MADCTL_ML BIT(4)
+
+#define ST7701S_RDDPM_DISPON BIT(2)
+#define ST7701S_RDDPM_SLPOUT BIT(4)
+
 #define ST7701S_CN2BKxSEL 0xFF
+#define ST7701S_CN2BKxSEL_NONE 0x00
+#define ST7701S_CN2BKxSEL_BK0 0x10
+#define ST7701S_CN2BKxSEL_BK1 0x11
 
 /* BK0 */
 
@@ -35,6 +73,9 @@
 #define ST7701S_INVSET 0xC2
 #define ST7701S_PVGAMCTRL 0xB0
 #define ST7701S_NVGAMCTRL 0xB1
+#define ST7701S_SDIR 0xC7
+
+#define ST7701S_SDIR_SS BIT(2)
 
 /* BK1 */
 
@@ -59,401 +100,2874 @@
 		}                                                                       \
 	} while (0)
 
-static const struct of_device_id jlt4013a_of_match[] = {
-	{ .compatible = "sitronix,st7701s" },
-	{ .compatible = "jinglitai,jlt4013a" },
-	{ /* sentinel */ }
-};
-MODULE_DEVICE_TABLE(of, jlt4013a_of_match);
+/*
+ * The longest parameter block in the init sequence is 16 bytes (gamma and
+ * GIP registers), anything bigger than that is refused at build time.
+ */
+#define ST7701S_MAX_PARAMS 16
+
+struct st7701s_cmd {
+	u8 cmd;
+	u8 len;
+	u16 delay_ms;
+	u8 data[ST7701S_MAX_PARAMS];
+};
+
+#define ST7701S_CMD_LEN(...) sizeof((u8[]){ __VA_ARGS__ })
+
+#define ST7701S_CMD_DELAY(_cmd, _delay_ms, ...)                                \
+	{                                                                      \
+		.cmd = (_cmd),                                                 \
+		.len = ST7701S_CMD_LEN(__VA_ARGS__) +                          \
+		       BUILD_BUG_ON_ZERO(ST7701S_CMD_LEN(__VA_ARGS__) >        \
+					 ST7701S_MAX_PARAMS),                  \
+		.delay_ms = (_delay_ms),                                       \
+		.data = { __VA_ARGS__ },                                       \
+	}
+
+#define ST7701S_CMD(_cmd, ...) ST7701S_CMD_DELAY(_cmd, 0, ##__VA_ARGS__)
+
+#define ST7701S_BKSEL(_bk) \
+	ST7701S_CMD(ST7701S_CN2BKxSEL, 0x77, 0x01, 0x00, 0x00, (_bk))
+
+/* The bank is the last parameter of CN2BKxSEL */
+#define ST7701S_BKSEL_LEN 5
+#define ST7701S_BANK_UNKNOWN 0xFF
+
+/*
+ * Register addresses for the regmap: the CN2 bank (0 for none, else 1 + the
+ * bank number), the command and the index of the parameter.
+ */
+#define ST7701S_REG_BANK GENMASK(14, 12)
+#define ST7701S_REG_CMD GENMASK(11, 4)
+#define ST7701S_REG_PARAM GENMASK(3, 0)
+
+struct st7701s_seq {
+	const char *name;
+	const struct st7701s_cmd *cmds;
+	unsigned int len;
+};
+
+#define ST7701S_SEQ(_name, _cmds)                                              \
+	{                                                                      \
+		.name = (_name), .cmds = (_cmds), .len = ARRAY_SIZE(_cmds),    \
+	}
+
+/* BK0 */
+
+static const struct st7701s_cmd jlt4013a_bk0[] = {
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_BK0),
+	ST7701S_CMD(ST7701S_INVSET, 0x31, 0x03),
+	ST7701S_CMD(0xCC, 0x10),
+};
+
+static const struct st7701s_cmd jlt4013a_gamma[] = {
+	ST7701S_CMD(ST7701S_PVGAMCTRL, 0x40, 0x01, 0x46, 0x0D, 0x13, 0x09,
+		    0x05, 0x09, 0x09, 0x1B, 0x07, 0x15, 0x12, 0x4C, 0x10, 0xC8),
+	ST7701S_CMD(ST7701S_NVGAMCTRL, 0x40, 0x02, 0x86, 0x0D, 0x13, 0x09,
+		    0x05, 0x09, 0x09, 0x1F, 0x07, 0x15, 0x12, 0x15, 0x19, 0x08),
+};
+
+/* BK1 */
+
+static const struct st7701s_cmd jlt4013a_bk1[] = {
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_BK1),
+	ST7701S_CMD(ST7701S_VRHS, 0x50),
+	ST7701S_CMD(ST7701S_VCOM, 0x68),
+	ST7701S_CMD(ST7701S_VGHSS, 0x07),
+	ST7701S_CMD(ST7701S_TESTCMD, 0x80),
+	ST7701S_CMD(ST7701S_VGLS, 0x47),
+	ST7701S_CMD(ST7701S_PWCTRL1, 0x85),
+	ST7701S_CMD(ST7701S_PWCTRL2, 0x21),
+	ST7701S_CMD(ST7701S_PWCTRL3, 0x10),
+	ST7701S_CMD(ST7701S_SPD1, 0x21, 0x36),
+	ST7701S_CMD_DELAY(ST7701S_SPD2, 120, 0x78),
+};
+
+/* Something strange */
+
+static const struct st7701s_cmd jlt4013a_gip[] = {
+	ST7701S_CMD(0xE0, 0x00, 0x00, 0x02),
+	ST7701S_CMD(0xE1, 0x08, 0x00, 0x0A, 0x00, 0x07, 0x00, 0x09, 0x00, 0x00,
+		    0x33, 0x33),
+	ST7701S_CMD(0xE2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		    0x00, 0x00, 0x00, 0x00),
+	ST7701S_CMD(0xE3, 0x00, 0x00, 0x33, 0x33),
+	ST7701S_CMD(0xE4, 0x44, 0x44),
+	ST7701S_CMD(0xE5, 0x0E, 0x2D, 0xA0, 0xA0, 0x10, 0x2D, 0xA0, 0xA0, 0x0A,
+		    0x2D, 0xA0, 0xA0, 0x0C, 0x2D, 0xA0, 0xA0),
+	ST7701S_CMD(0xE6, 0x00, 0x00, 0x33, 0x33),
+	ST7701S_CMD(0xE7, 0x44, 0x44),
+	ST7701S_CMD(0xE8, 0x0D, 0x2D, 0xA0, 0xA0, 0x0F, 0x2D, 0xA0, 0xA0, 0x09,
+		    0x2D, 0xA0, 0xA0, 0x0B, 0x2D, 0xA0, 0xA0),
+	ST7701S_CMD(0xEB, 0x02, 0x01, 0xE4, 0xE4, 0x44, 0x00, 0x40),
+	ST7701S_CMD(0xEC, 0x02, 0x01),
+	ST7701S_CMD(0xED, 0xAB, 0x89, 0x76, 0x54, 0x01, 0xFF, 0xFF, 0xFF, 0xFF,
+		    0xFF, 0xFF, 0x10, 0x45, 0x67, 0x98, 0xBA),
+};
+
+/* BK disable */
+
+static const struct st7701s_cmd jlt4013a_bk_disable[] = {
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_NONE),
+};
+
+/*
+ * Scan direction: SS reverses the source outputs and ML the gate scan, which
+ * together turn the picture by 180 degrees. Sent before the panel sequence.
+ *
+ * Every sequence of the profile selects the CN2 bank it writes to and leaves
+ * command set 1 selected when it is done, so that a firmware sequence starts
+ * the way it would right after SLPOUT.
+ */
+
+static const struct st7701s_cmd jlt4013a_scan_normal[] = {
+	ST7701S_CMD(ST7701S_MADCTL, 0x00),
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_BK0),
+	ST7701S_CMD(ST7701S_SDIR, 0x00),
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_NONE),
+};
+
+static const struct st7701s_cmd jlt4013a_scan_flipped[] = {
+	ST7701S_CMD(ST7701S_MADCTL, ST7701S_MADCTL_ML),
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_BK0),
+	ST7701S_CMD(ST7701S_SDIR, ST7701S_SDIR_SS),
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_NONE),
+};
+
+static const struct st7701s_seq jlt4013a_scan_normal_seq =
+	ST7701S_SEQ("scan", jlt4013a_scan_normal);
+static const struct st7701s_seq jlt4013a_scan_flipped_seq =
+	ST7701S_SEQ("scan", jlt4013a_scan_flipped);
+
+/*
+ * Pixel format of the RGB interface, the DPI field of COLMOD sits in bits 6:4
+ * and the same value is used for the MCU field. Sent after the panel
+ * sequence, so it also wins over a COLMOD from a firmware file.
+ */
+
+static const struct st7701s_cmd jlt4013a_colmod_16[] = {
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_NONE),
+	ST7701S_CMD(ST7701S_COLMOD, 0x55),
+};
+
+static const struct st7701s_cmd jlt4013a_colmod_18[] = {
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_NONE),
+	ST7701S_CMD(ST7701S_COLMOD, 0x66),
+};
+
+static const struct st7701s_cmd jlt4013a_colmod_24[] = {
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_NONE),
+	ST7701S_CMD(ST7701S_COLMOD, 0x77),
+};
+
+struct jlt4013a_format {
+	unsigned int bus_width;
+	u32 bus_format;
+	unsigned int bpc;
+	struct st7701s_seq seq;
+};
+
+static const struct jlt4013a_format jlt4013a_formats[] = {
+	{
+		.bus_width = 16,
+		.bus_format = MEDIA_BUS_FMT_RGB565_1X16,
+		.bpc = 6,
+		.seq = ST7701S_SEQ("format", jlt4013a_colmod_16),
+	},
+	{
+		.bus_width = 18,
+		.bus_format = MEDIA_BUS_FMT_RGB666_1X18,
+		.bpc = 6,
+		.seq = ST7701S_SEQ("format", jlt4013a_colmod_18),
+	},
+	{
+		.bus_width = 24,
+		.bus_format = MEDIA_BUS_FMT_RGB888_1X24,
+		.bpc = 8,
+		.seq = ST7701S_SEQ("format", jlt4013a_colmod_24),
+	},
+};
+
+/*
+ * Runs between SLPOUT and DISPON, whose delays come from the timing profile
+ * instead.
+ */
+static const struct st7701s_seq jlt4013a_init_sequence[] = {
+	ST7701S_SEQ("bk0", jlt4013a_bk0),
+	ST7701S_SEQ("gamma", jlt4013a_gamma),
+	ST7701S_SEQ("bk1", jlt4013a_bk1),
+	ST7701S_SEQ("gip", jlt4013a_gip),
+	ST7701S_SEQ("bk-disable", jlt4013a_bk_disable),
+};
+
+/*
+ * The init sequence can also be loaded as firmware, named by the
+ * "firmware-name" property. All fields are little endian:
+ *
+ *   header:  "JLTS", u16 version (1), u16 number of commands
+ *   command: u8 opcode, u8 number of parameters, u16 delay in ms,
+ *            parameters
+ *
+ * Like the built-in table, it runs between SLPOUT and DISPON, and starts with
+ * command set 1 selected.
+ */
+#define JLT4013A_FW_MAGIC "JLTS"
+#define JLT4013A_FW_VERSION 1
+
+struct jlt4013a_fw_header {
+	u8 magic[4];
+	__le16 version;
+	__le16 count;
+} __packed;
+
+struct jlt4013a_fw_cmd {
+	u8 cmd;
+	u8 len;
+	__le16 delay_ms;
+	u8 data[];
+} __packed;
+
+/* All delays are in microseconds */
+struct jlt4013a_timings {
+	u32 power_on;
+	u32 reset_assert;
+	u32 reset_release;
+	u32 sleep_out;
+	u32 sleep_in;
+	u32 display_on;
+};
+
+/*
+ * The ST7701S datasheet asks for a reset pulse of at least 10 us, 5 ms after
+ * releasing reset before the first command, 120 ms after SLPOUT and 120 ms
+ * after SLPIN before SLPOUT may be sent again. The power on and display on
+ * delays are margins for the supply ramp and the first frame.
+ */
+static const struct jlt4013a_timings jlt4013a_default_timings = {
+	.power_on = 10000,
+	.reset_assert = 10,
+	.reset_release = 5000,
+	.sleep_out = 120000,
+	.sleep_in = 120000,
+	.display_on = 20000,
+};
+
+/*
+ * About 55 Hz at full speed, then 40 and 30 Hz to leave DRAM bandwidth to
+ * the rest of the system. The slower modes keep the line timing, and add 15
+ * lines of vertical front porch so that they come out at whole rates.
+ */
+static const struct drm_display_mode jlt4013a_modes[] = {
+	{
+		.clock = 27000,
+		.hdisplay = 480,
+		.hsync_start = 480 + 32, // 512
+		.hsync_end = 480 + 32 + 11, // 523
+		.htotal = 480 + 32 + 11 + 2, // 525
+		.vdisplay = 800,
+		.vsync_start = 800 + 54, // 854
+		.vsync_end = 800 + 54 + 41, // 895
+		.vtotal = 800 + 54 + 41 + 33, // 928
+	},
+	{
+		.clock = 19800,
+		.hdisplay = 480,
+		.hsync_start = 480 + 32, // 512
+		.hsync_end = 480 + 32 + 11, // 523
+		.htotal = 480 + 32 + 11 + 2, // 525
+		.vdisplay = 800,
+		.vsync_start = 800 + 69, // 869
+		.vsync_end = 800 + 69 + 41, // 910
+		.vtotal = 800 + 69 + 41 + 33, // 943
+	},
+	{
+		.clock = 14850,
+		.hdisplay = 480,
+		.hsync_start = 480 + 32, // 512
+		.hsync_end = 480 + 32 + 11, // 523
+		.htotal = 480 + 32 + 11 + 2, // 525
+		.vdisplay = 800,
+		.vsync_start = 800 + 69, // 869
+		.vsync_end = 800 + 69 + 41, // 910
+		.vtotal = 800 + 69 + 41 + 33, // 943
+	},
+};
+
+/* Porch registers of each mode, VFP follows the mode's vertical front porch */
+static const struct st7701s_cmd jlt4013a_porch_full[] = {
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_BK0),
+	ST7701S_CMD(ST7701S_PORCTRL, 0x11, 0x02),
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_NONE),
+};
+
+static const struct st7701s_cmd jlt4013a_porch_slow[] = {
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_BK0),
+	ST7701S_CMD(ST7701S_PORCTRL, 0x11, 0x02 + 15),
+	ST7701S_BKSEL(ST7701S_CN2BKxSEL_NONE),
+};
+
+static const struct st7701s_seq jlt4013a_mode_seqs[] = {
+	ST7701S_SEQ("mode", jlt4013a_porch_full),
+	ST7701S_SEQ("mode", jlt4013a_porch_slow),
+	ST7701S_SEQ("mode", jlt4013a_porch_slow),
+};
+
+/*
+ * Everything that differs between ST7701S based panels. The first mode is
+ * the preferred one, and each mode comes with the registers it needs.
+ */
+struct jlt4013a_desc {
+	const struct st7701s_seq *seq;
+	unsigned int seq_len;
+	const struct drm_display_mode *modes;
+	const struct st7701s_seq *mode_seqs;
+	unsigned int num_modes;
+	const struct jlt4013a_timings *timings;
+	unsigned int bus_width;
+	u32 bus_flags;
+	unsigned int width_mm;
+	unsigned int height_mm;
+};
+
+static const struct jlt4013a_desc jlt4013a_desc = {
+	.seq = jlt4013a_init_sequence,
+	.seq_len = ARRAY_SIZE(jlt4013a_init_sequence),
+	.modes = jlt4013a_modes,
+	.mode_seqs = jlt4013a_mode_seqs,
+	.num_modes = ARRAY_SIZE(jlt4013a_modes) +
+		     BUILD_BUG_ON_ZERO(ARRAY_SIZE(jlt4013a_mode_seqs) !=
+				       ARRAY_SIZE(jlt4013a_modes)),
+	.timings = &jlt4013a_default_timings,
+	.bus_width = 24,
+	.bus_flags = DRM_BUS_FLAG_PIXDATA_DRIVE_POSEDGE,
+	.width_mm = 52,
+	.height_mm = 86,
+};
+
+static bool batch_writes = true;
+module_param(batch_writes, bool, 0644);
+MODULE_PARM_DESC(batch_writes,
+		 "Send each command's parameters as one SPI message (default: true)");
+
+static bool pipelined_init = true;
+module_param(pipelined_init, bool, 0644);
+MODULE_PARM_DESC(pipelined_init,
+		 "On a 3-wire bus, queue the whole init sequence with spi_async and let the controller do the delays (default: true)");
+
+static bool async_prepare;
+module_param(async_prepare, bool, 0644);
+MODULE_PARM_DESC(async_prepare,
+		 "Bring the panel up in the background from probe and prepare, and only wait for it in enable (default: false)");
+
+static bool sleep_on_unprepare = true;
+module_param(sleep_on_unprepare, bool, 0644);
+MODULE_PARM_DESC(sleep_on_unprepare,
+		 "Put the panel to sleep on unprepare instead of cutting its supply (default: true)");
+
+static unsigned int seamless_ms;
+module_param(seamless_ms, uint, 0644);
+MODULE_PARM_DESC(seamless_ms,
+		 "Keep the panel on this long after disable and unprepare, so that a mode switch only updates the registers that differ (default: 0)");
+
+static unsigned int esd_interval_ms;
+module_param(esd_interval_ms, uint, 0644);
+MODULE_PARM_DESC(esd_interval_ms,
+		 "Read back the power mode this often while displaying, and re-send the init sequence if it is wrong, 0 to disable (default: 0)");
+
+static const struct of_device_id jlt4013a_of_match[] = {
+	{ .compatible = "sitronix,st7701s", .data = &jlt4013a_desc },
+	{ .compatible = "jinglitai,jlt4013a", .data = &jlt4013a_desc },
+	{ /* sentinel */ }
+};
+MODULE_DEVICE_TABLE(of, jlt4013a_of_match);
+
+/*
+ * Without a DCX GPIO the panel is wired for 3-wire SPI, where the D/C flag is
+ * sent as the first bit of a 9-bit word. Controllers that cannot do 9-bit
+ * words get them packed into an 8-bit bitstream instead.
+ */
+enum st7701s_bus {
+	ST7701S_BUS_DCX,
+	ST7701S_BUS_9BIT,
+	ST7701S_BUS_9BIT_PACKED,
+};
+
+#define ST7701S_9BIT_DATA BIT(8)
+
+/* Enough for the longest run of commands without a delay in between */
+#define JLT4013A_TX9_WORDS 256
+
+/*
+ * A pipelined init sequence is split into at most this many messages, one per
+ * delay. Each message carries the data and then up to JLT4013A_MAX_DELAYS
+ * empty transfers, as a single transfer delay cannot exceed U16_MAX us.
+ */
+#define JLT4013A_MAX_SEGMENTS 8
+#define JLT4013A_MAX_DELAYS 4
+
+/* Packed words, plus up to 7 NOPs of padding in front of every segment */
+#define JLT4013A_TX_BYTES \
+	((JLT4013A_TX9_WORDS + 7 * JLT4013A_MAX_SEGMENTS) * 9 / 8)
+
+struct jlt4013a_segment {
+	unsigned int start;
+	unsigned int len;
+	u32 delay_us;
+};
+
+struct jlt4013a_pipeline {
+	bool active;
+	unsigned int seg_start;
+	unsigned int nsegs;
+	struct jlt4013a_segment segs[JLT4013A_MAX_SEGMENTS];
+	struct spi_message msgs[JLT4013A_MAX_SEGMENTS];
+	struct spi_transfer xfers[JLT4013A_MAX_SEGMENTS]
+				 [1 + JLT4013A_MAX_DELAYS];
+	atomic_t pending;
+	struct completion done;
+};
+
+/*
+ * How long an unprepared panel stays asleep with its supply on before runtime
+ * PM powers it off. Adjustable through power/autosuspend_delay_ms in sysfs.
+ */
+#define JLT4013A_AUTOSUSPEND_DELAY_MS 5000
+
+/*
+ * Everything that goes over the bus is staged here instead of being sent from
+ * the stack or from the const tables. It lives at the end of the driver
+ * context, and every part is aligned for DMA, so that mappings never share a
+ * cache line with other fields or with the opposite direction. That is the
+ * largest line a non-coherent DMA master may be behind, which can be bigger
+ * than the L1 line of the CPU.
+ */
+#ifdef ARCH_DMA_MINALIGN
+#define JLT4013A_DMA_MINALIGN ARCH_DMA_MINALIGN
+#else
+#define JLT4013A_DMA_MINALIGN __alignof__(unsigned long long)
+#endif
+
+struct jlt4013a_dma {
+	u16 words[JLT4013A_TX9_WORDS];
+	u8 tx[JLT4013A_TX_BYTES] __aligned(JLT4013A_DMA_MINALIGN);
+	u8 rx[1] __aligned(JLT4013A_DMA_MINALIGN);
+};
+
+/* Bus usage, reset at the start of every init sequence */
+struct jlt4013a_spi_stats {
+	u32 messages;
+	u32 bytes;
+	u32 dcx_writes;
+	u32 bank_skips;
+	u32 delays;
+	u64 delay_us;
+	u64 bus_ns;
+};
+
+/*
+ * Latency of one bring-up phase over all runs since the last reset. The
+ * histogram buckets are a quarter of an octave wide, so the p99 derived from
+ * it is within 25% of the real sample.
+ */
+#define JLT4013A_HIST_BUCKETS 96
+
+/*
+ * Phases timed outside of the profile. They index the start of the phase
+ * table, the sequences of the profile take the slots after them in profile
+ * order.
+ */
+enum jlt4013a_phase {
+	JLT4013A_PHASE_POWER,
+	JLT4013A_PHASE_RESET,
+	JLT4013A_PHASE_SLEEP_OUT,
+	JLT4013A_PHASE_REGCACHE,
+	JLT4013A_PHASE_TOTAL,
+	JLT4013A_PHASE_DISPLAY_ON,
+	JLT4013A_PHASE_SLEEP_IN,
+	JLT4013A_PHASE_WAKE_SLEEP_OUT,
+	JLT4013A_PHASE_WAKE_DELTA,
+	JLT4013A_PHASE_SWITCH,
+	JLT4013A_PHASE_ESD_CHECK,
+	JLT4013A_PHASE_ESD_RECOVER,
+	JLT4013A_NR_PHASES,
+};
+
+static const char *const jlt4013a_phase_names[JLT4013A_NR_PHASES] = {
+	[JLT4013A_PHASE_POWER] = "power",
+	[JLT4013A_PHASE_RESET] = "reset",
+	[JLT4013A_PHASE_SLEEP_OUT] = "sleep-out",
+	[JLT4013A_PHASE_REGCACHE] = "regcache",
+	[JLT4013A_PHASE_TOTAL] = "total",
+	[JLT4013A_PHASE_DISPLAY_ON] = "display-on",
+	[JLT4013A_PHASE_SLEEP_IN] = "sleep-in",
+	[JLT4013A_PHASE_WAKE_SLEEP_OUT] = "wake-sleep-out",
+	[JLT4013A_PHASE_WAKE_DELTA] = "wake-delta",
+	[JLT4013A_PHASE_SWITCH] = "switch",
+	[JLT4013A_PHASE_ESD_CHECK] = "esd-check",
+	[JLT4013A_PHASE_ESD_RECOVER] = "esd-recover",
+};
+
+/* Slot of sequence i of the profile */
+#define JLT4013A_PHASE_SEQ(i) (JLT4013A_NR_PHASES + (i))
+#define JLT4013A_MAX_PHASES JLT4013A_PHASE_SEQ(JLT4013A_MAX_SEQS)
+
+struct jlt4013a_phase_stats {
+	u32 count;
+	u32 min_us;
+	u32 max_us;
+	u64 sum_us;
+	u32 hist[JLT4013A_HIST_BUCKETS];
+};
+
+/*
+ * Power state of the panel. Sleeping keeps the supply and the registers, the
+ * others follow the order of a bring-up.
+ */
+enum jlt4013a_state {
+	JLT4013A_OFF,
+	JLT4013A_POWERED,
+	JLT4013A_INITIALIZED,
+	JLT4013A_DISPLAYING,
+	JLT4013A_SLEEPING,
+	JLT4013A_NR_STATES,
+};
+
+static const char *const jlt4013a_state_names[] = {
+	[JLT4013A_OFF] = "off",
+	[JLT4013A_POWERED] = "powered",
+	[JLT4013A_INITIALIZED] = "initialized",
+	[JLT4013A_DISPLAYING] = "displaying",
+	[JLT4013A_SLEEPING] = "sleeping",
+};
+
+/* Panel hooks that found the panel already in the requested state */
+enum jlt4013a_hook {
+	JLT4013A_PREPARE,
+	JLT4013A_UNPREPARE,
+	JLT4013A_ENABLE,
+	JLT4013A_DISABLE,
+	JLT4013A_NR_HOOKS,
+};
+
+static const char *const jlt4013a_hook_names[] = {
+	[JLT4013A_PREPARE] = "prepare",
+	[JLT4013A_UNPREPARE] = "unprepare",
+	[JLT4013A_ENABLE] = "enable",
+	[JLT4013A_DISABLE] = "disable",
+};
+
+/*
+ * What runs between SLPOUT and DISPON: scan direction, the registers of the
+ * mode, the panel sequence and the pixel format
+ */
+#define JLT4013A_MAX_SEQS 8
+
+/*
+ * Consecutive bad power modes before the panel is re-initialized, so that a
+ * single misread does not cost a whole init sequence
+ */
+#define JLT4013A_ESD_BAD_READS 3
+
+/* Health check counters, its cost goes to the esd-* phases */
+struct jlt4013a_esd_stats {
+	u32 checks;
+	u32 read_errors;
+	u32 bad_state;
+	u32 bad_streak;
+	u32 recoveries;
+	u32 failed_recoveries;
+	u8 last_mode;
+	bool stopped;
+};
+
+/*
+ * Every parameter block sent since the last reset, keyed by the CN2 bank that
+ * was selected at the time, along with the bank that is selected now. Blocks
+ * that do not fit are not recorded and count as unknown.
+ */
+#define JLT4013A_SHADOW_REGS 48
+
+struct st7701s_reg {
+	u8 bank;
+	u8 cmd;
+	u8 len;
+	u8 data[ST7701S_MAX_PARAMS];
+};
+
+struct jlt4013a_shadow {
+	u8 bank;
+	unsigned int nregs;
+	struct st7701s_reg regs[JLT4013A_SHADOW_REGS];
+};
+
+struct jlt4013a {
+	struct drm_panel panel;
+	struct spi_device *spi;
+	const struct jlt4013a_desc *desc;
+	struct gpio_desc *reset;
+	struct gpio_desc *dcx;
+	struct regulator *supply;
+	struct jlt4013a_timings timings;
+	const struct st7701s_seq *seq;
+	unsigned int seq_len;
+	struct st7701s_seq fw_seq;
+	struct st7701s_seq profile[JLT4013A_MAX_SEQS];
+	unsigned int profile_len;
+	bool flip;
+	enum drm_panel_orientation orientation;
+	const struct jlt4013a_format *format;
+	struct drm_connector *connector;
+	unsigned int mode;
+	bool mode_changed;
+	struct notifier_block supply_nb;
+	bool supply_lost;
+	struct mutex lock;
+	enum jlt4013a_state state;
+	u32 transitions[JLT4013A_NR_STATES][JLT4013A_NR_STATES];
+	u32 redundant[JLT4013A_NR_HOOKS];
+	struct delayed_work blank_work;
+	bool blank_pending;
+	bool sleep_pending;
+	u32 switches;
+	struct delayed_work esd_work;
+	struct jlt4013a_esd_stats esd;
+	ktime_t sleep_start;
+	bool handoff;
+	struct work_struct bringup_work;
+	struct completion bringup_done;
+	bool bringup_queued;
+	int bringup_ret;
+	enum st7701s_bus bus;
+	unsigned int tx9_len;
+	struct jlt4013a_pipeline *pipe;
+	struct jlt4013a_spi_stats stats;
+	struct jlt4013a_shadow shadow;
+	struct regmap *regmap;
+	ktime_t phase_start;
+	struct jlt4013a_phase_stats phases[JLT4013A_MAX_PHASES];
+	struct work_struct cycle_work;
+	atomic_t cycles;
+	bool cycling;
+	struct dentry *debugfs;
+	struct jlt4013a_dma dma __aligned(JLT4013A_DMA_MINALIGN);
+};
+
+static int st7701s_spi_write(struct jlt4013a *ctx, const void *buf, size_t len,
+			     u8 bits_per_word)
+{
+	struct spi_transfer xfer = {};
+	struct spi_message msg;
+	ktime_t start;
+	int ret;
+
+	spi_message_init(&msg);
+
+	xfer.tx_buf = buf;
+	xfer.bits_per_word = bits_per_word;
+	xfer.len = len;
+
+	spi_message_add_tail(&xfer, &msg);
+
+	start = ktime_get();
+	ret = spi_sync(ctx->spi, &msg);
+	ctx->stats.bus_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	ctx->stats.messages++;
+	ctx->stats.bytes += len;
+
+	return ret;
+}
+
+static void st7701s_set_dcx(struct jlt4013a *ctx, int value)
+{
+	gpiod_set_value(ctx->dcx, value);
+	ctx->stats.dcx_writes++;
+}
+
+static int st7701s_write_command(struct jlt4013a *ctx, u8 cmd)
+{
+	st7701s_set_dcx(ctx, 0);
+
+	ctx->dma.tx[0] = cmd;
+	return st7701s_spi_write(ctx, ctx->dma.tx, 1, 8);
+}
+
+static int st7701s_write_data(struct jlt4013a *ctx, u8 cmd)
+{
+	st7701s_set_dcx(ctx, 1);
+
+	ctx->dma.tx[0] = cmd;
+	return st7701s_spi_write(ctx, ctx->dma.tx, 1, 8);
+}
+
+/*
+ * Sends a command followed by its parameter block. DCX is a plain GPIO, so it
+ * cannot change in the middle of a message: the opcode and the parameters go
+ * out as two messages, and DCX only toggles once in between.
+ */
+static int st7701s_write_dcx(struct jlt4013a *ctx, u8 cmd, const u8 *data,
+			     size_t len)
+{
+	int ret;
+	size_t i;
+
+	ret = st7701s_write_command(ctx, cmd);
+	if (ret || !len)
+		return ret;
+
+	if (batch_writes) {
+		st7701s_set_dcx(ctx, 1);
+		memcpy(ctx->dma.tx, data, len);
+		return st7701s_spi_write(ctx, ctx->dma.tx, len, 8);
+	}
+
+	for (i = 0; i < len; i++) {
+		ret = st7701s_write_data(ctx, data[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Packs 9-bit words MSB first into bytes. The stream is padded at the front
+ * with NOP commands (0x000) to a multiple of 8 words, so that it ends on a
+ * byte boundary and no partial word is clocked into the panel.
+ */
+static size_t st7701s_pack9(u8 *dst, const u16 *src, unsigned int words)
+{
+	unsigned int pad = (8 - words % 8) % 8;
+	unsigned int bits = 9 * pad;
+	size_t len = bits / 8;
+	unsigned int i;
+	u32 acc = 0;
+
+	memset(dst, 0, len);
+	bits %= 8;
+
+	for (i = 0; i < words; i++) {
+		acc = (acc << 9) | (src[i] & 0x1ff);
+		bits += 9;
+		while (bits >= 8) {
+			bits -= 8;
+			dst[len++] = acc >> bits;
+		}
+		acc &= BIT(bits) - 1;
+	}
+
+	return len;
+}
+
+static int st7701s_flush9(struct jlt4013a *ctx)
+{
+	unsigned int words = ctx->tx9_len;
+	size_t len;
+
+	if (!words)
+		return 0;
+
+	ctx->tx9_len = 0;
+
+	if (ctx->bus == ST7701S_BUS_9BIT)
+		return st7701s_spi_write(ctx, ctx->dma.words,
+					 words * sizeof(u16), 9);
+
+	len = st7701s_pack9(ctx->dma.tx, ctx->dma.words, words);
+	return st7701s_spi_write(ctx, ctx->dma.tx, len, 8);
+}
+
+static void st7701s_set_delay(struct spi_transfer *xfer, u16 us)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,5,0)
+	xfer->delay.value = us;
+	xfer->delay.unit = SPI_DELAY_UNIT_USECS;
+#else
+	xfer->delay_usecs = us;
+#endif
+}
+
+static void st7701s_pipeline_complete(void *context)
+{
+	struct jlt4013a_pipeline *pipe = context;
+
+	if (atomic_dec_and_test(&pipe->pending))
+		complete(&pipe->done);
+}
+
+static int st7701s_pipeline_close(struct jlt4013a *ctx, u32 delay_us)
+{
+	struct jlt4013a_pipeline *pipe = ctx->pipe;
+	struct jlt4013a_segment *seg;
+
+	/* It would become a message without transfers, which spi_async refuses */
+	if (ctx->tx9_len == pipe->seg_start && !delay_us)
+		return 0;
+
+	if (pipe->nsegs == JLT4013A_MAX_SEGMENTS)
+		return -ENOSPC;
+
+	seg = &pipe->segs[pipe->nsegs++];
+	seg->start = pipe->seg_start;
+	seg->len = ctx->tx9_len - pipe->seg_start;
+	seg->delay_us = delay_us;
+
+	pipe->seg_start = ctx->tx9_len;
+	return 0;
+}
+
+/*
+ * Turns the queued segments into one spi_message each, with the delays that
+ * follow them done by the controller, submits them all with spi_async() and
+ * waits once for the last one to complete.
+ */
+static int st7701s_pipeline_run(struct jlt4013a *ctx)
+{
+	struct jlt4013a_pipeline *pipe = ctx->pipe;
+	struct jlt4013a_segment *seg;
+	struct spi_transfer *xfer;
+	unsigned int i, n, nsegs;
+	size_t off = 0;
+	ktime_t start;
+	u32 delay, d;
+	int ret = 0;
+
+	ret = st7701s_pipeline_close(ctx, 0);
+	if (ret)
+		return ret;
+
+	nsegs = pipe->nsegs;
+	if (!nsegs)
+		return 0;
+
+	for (i = 0; i < nsegs; i++) {
+		seg = &pipe->segs[i];
+		xfer = pipe->xfers[i];
+		memset(pipe->xfers[i], 0, sizeof(pipe->xfers[i]));
+		n = 0;
+
+		if (seg->len && ctx->bus == ST7701S_BUS_9BIT) {
+			xfer[n].tx_buf = &ctx->dma.words[seg->start];
+			xfer[n].len = seg->len * sizeof(u16);
+			xfer[n++].bits_per_word = 9;
+		} else if (seg->len) {
+			xfer[n].tx_buf = &ctx->dma.tx[off];
+			xfer[n].len = st7701s_pack9(&ctx->dma.tx[off],
+						    &ctx->dma.words[seg->start],
+						    seg->len);
+			xfer[n++].bits_per_word = 8;
+			off += xfer[0].len;
+		}
+
+		for (delay = seg->delay_us; delay; delay -= d) {
+			d = min_t(u32, delay, U16_MAX);
+			st7701s_set_delay(&xfer[n++], d);
+		}
+
+		spi_message_init_with_transfers(&pipe->msgs[i], xfer, n);
+		pipe->msgs[i].complete = st7701s_pipeline_complete;
+		pipe->msgs[i].context = pipe;
+
+		ctx->stats.messages++;
+		ctx->stats.bytes += xfer[0].len;
+	}
+
+	atomic_set(&pipe->pending, nsegs);
+	reinit_completion(&pipe->done);
+
+	start = ktime_get();
+	for (i = 0; i < nsegs; i++) {
+		ret = spi_async(ctx->spi, &pipe->msgs[i]);
+		if (ret) {
+			/* The messages that were not queued never complete */
+			if (atomic_sub_and_test(nsegs - i, &pipe->pending))
+				complete(&pipe->done);
+			nsegs = i;
+			break;
+		}
+	}
+
+	wait_for_completion(&pipe->done);
+	ctx->stats.bus_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	for (i = 0; i < nsegs && !ret; i++)
+		ret = pipe->msgs[i].status;
+
+	ctx->tx9_len = 0;
+	pipe->seg_start = 0;
+	pipe->nsegs = 0;
+
+	return ret;
+}
+
+static int st7701s_pipeline_delay(struct jlt4013a *ctx, u32 us)
+{
+	struct jlt4013a_pipeline *pipe = ctx->pipe;
+	int ret;
+
+	/* One segment is kept free for what follows the last delay */
+	if (pipe->nsegs >= JLT4013A_MAX_SEGMENTS - 1) {
+		ret = st7701s_pipeline_run(ctx);
+		if (ret)
+			return ret;
+	}
+
+	if (DIV_ROUND_UP(us, U16_MAX) > JLT4013A_MAX_DELAYS) {
+		ret = st7701s_pipeline_run(ctx);
+		if (ret)
+			return ret;
+
+		fsleep(us);
+		return 0;
+	}
+
+	return st7701s_pipeline_close(ctx, us);
+}
+
+/*
+ * Between st7701s_pipeline_begin() and st7701s_pipeline_end() nothing is
+ * sent: commands and delays are only recorded, and then go out in one go.
+ * This needs a 3-wire bus, as the DCX GPIO cannot be driven from a queued
+ * message.
+ */
+static void st7701s_pipeline_begin(struct jlt4013a *ctx)
+{
+	if (ctx->pipe && pipelined_init)
+		ctx->pipe->active = true;
+}
+
+static void st7701s_pipeline_discard(struct jlt4013a *ctx)
+{
+	ctx->tx9_len = 0;
+
+	if (!ctx->pipe)
+		return;
+
+	ctx->pipe->active = false;
+	ctx->pipe->seg_start = 0;
+	ctx->pipe->nsegs = 0;
+}
+
+static int st7701s_pipeline_end(struct jlt4013a *ctx)
+{
+	int ret;
+
+	if (!ctx->pipe || !ctx->pipe->active)
+		return 0;
+
+	ret = st7701s_pipeline_run(ctx);
+	ctx->pipe->active = false;
+
+	return ret;
+}
+
+static int st7701s_queue9(struct jlt4013a *ctx, u8 cmd, const u8 *data,
+			  size_t len)
+{
+	int ret;
+	size_t i;
+
+	if (ctx->tx9_len + 1 + len > JLT4013A_TX9_WORDS) {
+		if (ctx->pipe && ctx->pipe->active)
+			ret = st7701s_pipeline_run(ctx);
+		else
+			ret = st7701s_flush9(ctx);
+		if (ret)
+			return ret;
+	}
+
+	ctx->dma.words[ctx->tx9_len++] = cmd;
+	for (i = 0; i < len; i++)
+		ctx->dma.words[ctx->tx9_len++] = ST7701S_9BIT_DATA | data[i];
+
+	return 0;
+}
+
+static void st7701s_shadow_reset(struct jlt4013a *ctx, u8 bank)
+{
+	ctx->shadow.bank = bank;
+	ctx->shadow.nregs = 0;
+}
+
+static struct st7701s_reg *st7701s_shadow_find(struct jlt4013a *ctx, u8 bank,
+					       u8 cmd)
+{
+	struct st7701s_reg *reg;
+	unsigned int i;
+
+	for (i = 0; i < ctx->shadow.nregs; i++) {
+		reg = &ctx->shadow.regs[i];
+		if (reg->bank == bank && reg->cmd == cmd)
+			return reg;
+	}
+
+	return NULL;
+}
+
+static void st7701s_shadow_update(struct jlt4013a *ctx, u8 cmd,
+				  const u8 *data, size_t len)
+{
+	struct jlt4013a_shadow *shadow = &ctx->shadow;
+	struct st7701s_reg *reg;
+
+	if (cmd == ST7701S_CN2BKxSEL && len == ST7701S_BKSEL_LEN) {
+		shadow->bank = data[ST7701S_BKSEL_LEN - 1];
+		return;
+	}
+
+	if (!len || len > ST7701S_MAX_PARAMS)
+		return;
+
+	reg = st7701s_shadow_find(ctx, shadow->bank, cmd);
+	if (!reg) {
+		if (shadow->nregs == JLT4013A_SHADOW_REGS)
+			return;
+
+		reg = &shadow->regs[shadow->nregs++];
+		reg->bank = shadow->bank;
+		reg->cmd = cmd;
+	}
+
+	reg->len = len;
+	memcpy(reg->data, data, len);
+}
+
+/*
+ * Queues a command and its parameters. On a 3-wire bus commands are collected
+ * until st7701s_flush() and then go out as one transfer; with a DCX GPIO they
+ * are written immediately.
+ */
+static int st7701s_queue(struct jlt4013a *ctx, u8 cmd, const u8 *data,
+			 size_t len)
+{
+	int ret;
+
+	/* The bank is already selected */
+	if (cmd == ST7701S_CN2BKxSEL && len == ST7701S_BKSEL_LEN &&
+	    data[ST7701S_BKSEL_LEN - 1] == ctx->shadow.bank) {
+		ctx->stats.bank_skips++;
+		return 0;
+	}
+
+	trace_jlt4013a_cmd(cmd, data, len);
+
+	if (ctx->bus == ST7701S_BUS_DCX)
+		ret = st7701s_write_dcx(ctx, cmd, data, len);
+	else
+		ret = st7701s_queue9(ctx, cmd, data, len);
+
+	if (!ret)
+		st7701s_shadow_update(ctx, cmd, data, len);
+
+	return ret;
+}
+
+static int st7701s_flush(struct jlt4013a *ctx)
+{
+	if (ctx->bus == ST7701S_BUS_DCX)
+		return 0;
+
+	if (ctx->pipe && ctx->pipe->active)
+		return 0;
+
+	return st7701s_flush9(ctx);
+}
+
+static int st7701s_delay(struct jlt4013a *ctx, u32 us)
+{
+	int ret;
+
+	ctx->stats.delays++;
+	ctx->stats.delay_us += us;
+
+	if (ctx->pipe && ctx->pipe->active)
+		return st7701s_pipeline_delay(ctx, us);
+
+	ret = st7701s_flush(ctx);
+	if (ret)
+		return ret;
+
+	fsleep(us);
+	return 0;
+}
+
+static int st7701s_write(struct jlt4013a *ctx, u8 cmd, const u8 *data,
+			 size_t len)
+{
+	int ret;
+
+	ret = st7701s_queue(ctx, cmd, data, len);
+	if (ret)
+		return ret;
+
+	return st7701s_flush(ctx);
+}
+
+/*
+ * Reads back a single byte register. On a 3-wire bus the opcode is sent as a
+ * 9-bit word, or packed behind seven NOPs so that it ends on a byte boundary.
+ */
+static int st7701s_read(struct jlt4013a *ctx, u8 cmd, u8 *val)
+{
+	struct spi_transfer xfer[2] = {};
+	struct spi_message msg;
+	int ret;
+
+	ret = st7701s_flush(ctx);
+	if (ret)
+		return ret;
+
+	switch (ctx->bus) {
+	case ST7701S_BUS_DCX:
+		st7701s_set_dcx(ctx, 0);
+		ctx->dma.tx[0] = cmd;
+		xfer[0].tx_buf = ctx->dma.tx;
+		xfer[0].len = 1;
+		xfer[0].bits_per_word = 8;
+		break;
+	case ST7701S_BUS_9BIT:
+		ctx->dma.words[0] = cmd;
+		xfer[0].tx_buf = ctx->dma.words;
+		xfer[0].len = sizeof(u16);
+		xfer[0].bits_per_word = 9;
+		break;
+	case ST7701S_BUS_9BIT_PACKED:
+		ctx->dma.words[0] = cmd;
+		xfer[0].tx_buf = ctx->dma.tx;
+		xfer[0].len = st7701s_pack9(ctx->dma.tx, ctx->dma.words, 1);
+		xfer[0].bits_per_word = 8;
+		break;
+	}
+
+	xfer[1].rx_buf = ctx->dma.rx;
+	xfer[1].len = 1;
+	xfer[1].bits_per_word = 8;
+
+	spi_message_init_with_transfers(&msg, xfer, ARRAY_SIZE(xfer));
+
+	ret = spi_sync(ctx->spi, &msg);
+	if (ret)
+		return ret;
+
+	*val = ctx->dma.rx[0];
+	return 0;
+}
+
+static unsigned int jlt4013a_hist_bucket(u32 us)
+{
+	unsigned int msb;
+
+	if (us < 4)
+		return us;
+
+	msb = fls(us) - 1;
+	return min_t(unsigned int, (msb - 1) * 4 + ((us >> (msb - 2)) & 3),
+		     JLT4013A_HIST_BUCKETS - 1);
+}
+
+/* First value past the bucket, the inverse of jlt4013a_hist_bucket() */
+static u32 jlt4013a_hist_limit(unsigned int bucket)
+{
+	if (bucket < 4)
+		return bucket + 1;
+
+	return (5 + bucket % 4) << (bucket / 4 - 1);
+}
+
+static const char *jlt4013a_phase_name(struct jlt4013a *ctx,
+				       unsigned int phase)
+{
+	if (phase < JLT4013A_NR_PHASES)
+		return jlt4013a_phase_names[phase];
+
+	return ctx->profile[phase - JLT4013A_NR_PHASES].name;
+}
+
+static void jlt4013a_phase_record(struct jlt4013a *ctx, unsigned int phase,
+				  u32 us)
+{
+	struct jlt4013a_phase_stats *stats = &ctx->phases[phase];
+
+	if (!stats->count++) {
+		stats->min_us = us;
+		stats->max_us = us;
+	}
+	stats->min_us = min(stats->min_us, us);
+	stats->max_us = max(stats->max_us, us);
+	stats->sum_us += us;
+	stats->hist[jlt4013a_hist_bucket(us)]++;
+}
+
+/*
+ * Phases are traced and timed from the CPU. On a 3-wire bus queued commands
+ * are only sent when the buffer is flushed, and in a pipelined init nothing
+ * is sent before the end, so there the time of a phase is mostly the time it
+ * took to queue it.
+ */
+static void jlt4013a_phase_begin(struct jlt4013a *ctx, unsigned int phase)
+{
+	trace_jlt4013a_phase_begin(jlt4013a_phase_name(ctx, phase));
+	ctx->phase_start = ktime_get();
+}
+
+static void jlt4013a_phase_end(struct jlt4013a *ctx, unsigned int phase)
+{
+	u32 us = ktime_us_delta(ktime_get(), ctx->phase_start);
+
+	trace_jlt4013a_phase_end(jlt4013a_phase_name(ctx, phase));
+	jlt4013a_phase_record(ctx, phase, us);
+}
+
+static int st7701s_run_cmds(struct jlt4013a *ctx,
+			    const struct st7701s_cmd *cmds, unsigned int len)
+{
+	int ret;
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		ST7701S_TRY(ret, st7701s_queue(ctx, cmds[i].cmd, cmds[i].data,
+					       cmds[i].len));
+		if (cmds[i].delay_ms)
+			ST7701S_TRY(ret, st7701s_delay(ctx, cmds[i].delay_ms *
+							       USEC_PER_MSEC));
+	}
+
+	return 0;
+}
+
+static int st7701s_run_sequence(struct jlt4013a *ctx,
+				const struct st7701s_seq *seq, unsigned int len)
+{
+	int ret;
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		jlt4013a_phase_begin(ctx, JLT4013A_PHASE_SEQ(i));
+		ret = st7701s_run_cmds(ctx, seq[i].cmds, seq[i].len);
+		jlt4013a_phase_end(ctx, JLT4013A_PHASE_SEQ(i));
+		if (ret)
+			return ret;
+	}
+
+	return st7701s_flush(ctx);
+}
+
+static int st7701s_select_bank(struct jlt4013a *ctx, u8 bank)
+{
+	const u8 data[ST7701S_BKSEL_LEN] = { 0x77, 0x01, 0x00, 0x00, bank };
+
+	return st7701s_queue(ctx, ST7701S_CN2BKxSEL, data, sizeof(data));
+}
+
+static unsigned int st7701s_reg(u8 bank, u8 cmd, unsigned int param)
+{
+	unsigned int bk = bank == ST7701S_CN2BKxSEL_NONE ? 0 : (bank & 0x0F) + 1;
+
+	return FIELD_PREP(ST7701S_REG_BANK, bk) |
+	       FIELD_PREP(ST7701S_REG_CMD, cmd) |
+	       FIELD_PREP(ST7701S_REG_PARAM, param);
+}
+
+static u8 st7701s_reg_bank(unsigned int reg)
+{
+	unsigned int bk = FIELD_GET(ST7701S_REG_BANK, reg);
+
+	return bk ? ST7701S_CN2BKxSEL_BK0 + bk - 1 : ST7701S_CN2BKxSEL_NONE;
+}
+
+/*
+ * A write to part of a parameter block still has to send the block from its
+ * first parameter, the rest is taken from the shadow. A write that starts
+ * past what the shadow holds would leave a gap nobody knows the value of, so
+ * it is refused. Blocks that already hold the value are not sent again.
+ */
+static int jlt4013a_regmap_write_block(struct jlt4013a *ctx, unsigned int reg,
+				       const u8 *vals, size_t n)
+{
+	u8 bank = st7701s_reg_bank(reg);
+	u8 cmd = FIELD_GET(ST7701S_REG_CMD, reg);
+	unsigned int param = FIELD_GET(ST7701S_REG_PARAM, reg);
+	const struct st7701s_reg *cur;
+	u8 block[ST7701S_MAX_PARAMS];
+	size_t len = param + n;
+	int ret;
+
+	cur = st7701s_shadow_find(ctx, bank, cmd);
+	if (param > (cur ? cur->len : 0))
+		return -EINVAL;
+	if (cur) {
+		memcpy(block, cur->data, cur->len);
+		len = max_t(size_t, len, cur->len);
+	}
+	memcpy(block + param, vals, n);
+
+	if (cur && cur->len == len && !memcmp(cur->data, block, len))
+		return 0;
+
+	ret = st7701s_select_bank(ctx, bank);
+	if (ret)
+		return ret;
+
+	return st7701s_write(ctx, cmd, block, len);
+}
+
+/*
+ * The register space is contiguous across commands, so a raw write from a
+ * cache sync may run into the following blocks.
+ */
+static int jlt4013a_regmap_write(void *context, const void *data, size_t count)
+{
+	struct jlt4013a *ctx = context;
+	unsigned int reg = get_unaligned_be16(data);
+	const u8 *vals = data + sizeof(u16);
+	size_t n = count - sizeof(u16);
+	size_t chunk;
+	int ret;
+
+	while (n) {
+		chunk = min_t(size_t, n,
+			      ST7701S_MAX_PARAMS -
+				      FIELD_GET(ST7701S_REG_PARAM, reg));
+
+		ret = jlt4013a_regmap_write_block(ctx, reg, vals, chunk);
+		if (ret)
+			return ret;
+
+		reg += chunk;
+		vals += chunk;
+		n -= chunk;
+	}
+
+	return 0;
+}
+
+/* The parameters are write-only, reads return what was last sent */
+static int jlt4013a_regmap_read(void *context, const void *reg_buf,
+				size_t reg_size, void *val_buf, size_t val_size)
+{
+	struct jlt4013a *ctx = context;
+	unsigned int reg = get_unaligned_be16(reg_buf);
+	unsigned int param = FIELD_GET(ST7701S_REG_PARAM, reg);
+	const struct st7701s_reg *cur;
+
+	cur = st7701s_shadow_find(ctx, st7701s_reg_bank(reg),
+				  FIELD_GET(ST7701S_REG_CMD, reg));
+	if (!cur || param + val_size > cur->len)
+		return -EIO;
+
+	memcpy(val_buf, cur->data + param, val_size);
+	return 0;
+}
+
+static bool jlt4013a_regmap_readable(struct device *dev, unsigned int reg)
+{
+	struct jlt4013a *ctx = dev_get_drvdata(dev);
+	const struct st7701s_reg *cur;
+
+	cur = st7701s_shadow_find(ctx, st7701s_reg_bank(reg),
+				  FIELD_GET(ST7701S_REG_CMD, reg));
+	return cur && FIELD_GET(ST7701S_REG_PARAM, reg) < cur->len;
+}
+
+static const struct regmap_bus jlt4013a_regmap_bus = {
+	.write = jlt4013a_regmap_write,
+	.read = jlt4013a_regmap_read,
+	.reg_format_endian_default = REGMAP_ENDIAN_BIG,
+	.val_format_endian_default = REGMAP_ENDIAN_BIG,
+};
+
+/*
+ * The cache holds the registers that were changed at runtime. The init
+ * sequence itself goes straight to the transport, so that it keeps its
+ * batching, and the cache is synced on top of it.
+ */
+static const struct regmap_config jlt4013a_regmap_config = {
+	.reg_bits = 16,
+	.val_bits = 8,
+	.max_register = ST7701S_REG_BANK | ST7701S_REG_CMD | ST7701S_REG_PARAM,
+	.readable_reg = jlt4013a_regmap_readable,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,4,0)
+	.cache_type = REGCACHE_MAPLE,
+#else
+	.cache_type = REGCACHE_RBTREE,
+#endif
+};
+
+/* Only meaningful while the regcache is in cache-only mode */
+static bool jlt4013a_reg_cached(struct jlt4013a *ctx,
+				const struct st7701s_cmd *cmd, u8 bank)
+{
+	unsigned int i, val;
+
+	for (i = 0; i < cmd->len; i++)
+		if (!regmap_read(ctx->regmap, st7701s_reg(bank, cmd->cmd, i),
+				 &val))
+			return true;
+
+	return false;
+}
+
+/*
+ * Sends only the parameter blocks of a sequence that differ from the shadow,
+ * along with the bank selects they need, and leaves the bank where the
+ * sequence would. Commands without parameters are actions rather than
+ * state, and are not repeated. Blocks that were changed at runtime are left
+ * in the regcache for jlt4013a_sync_regcache() to send, which the caller has
+ * to do next. Returns the number of blocks sent.
+ */
+static int st7701s_run_delta(struct jlt4013a *ctx,
+			     const struct st7701s_seq *seq, unsigned int len)
+{
+	const struct st7701s_cmd *cmd;
+	struct st7701s_reg *reg;
+	u8 bank = ST7701S_CN2BKxSEL_NONE;
+	unsigned int i, j;
+	int ret, sent = 0;
+
+	regcache_cache_only(ctx->regmap, true);
+
+	for (i = 0; i < len; i++) {
+		for (j = 0; j < seq[i].len; j++) {
+			cmd = &seq[i].cmds[j];
+
+			if (cmd->cmd == ST7701S_CN2BKxSEL &&
+			    cmd->len == ST7701S_BKSEL_LEN) {
+				bank = cmd->data[ST7701S_BKSEL_LEN - 1];
+				continue;
+			}
+
+			if (!cmd->len)
+				continue;
+
+			reg = st7701s_shadow_find(ctx, bank, cmd->cmd);
+			if (reg && reg->len == cmd->len &&
+			    !memcmp(reg->data, cmd->data, cmd->len))
+				continue;
+
+			if (jlt4013a_reg_cached(ctx, cmd, bank))
+				continue;
+
+			ST7701S_TRY(ret, st7701s_select_bank(ctx, bank));
+			ST7701S_TRY(ret, st7701s_queue(ctx, cmd->cmd, cmd->data,
+						       cmd->len));
+			if (cmd->delay_ms)
+				ST7701S_TRY(ret,
+					    st7701s_delay(ctx, cmd->delay_ms *
+							       USEC_PER_MSEC));
+			sent++;
+		}
+	}
+
+	ST7701S_TRY(ret, st7701s_select_bank(ctx, bank));
+	ST7701S_TRY(ret, st7701s_flush(ctx));
+	return sent;
+}
+
+/*
+ * Replays the registers that were changed at runtime, after the init
+ * sequence or a wake put the profile values back.
+ */
+static int jlt4013a_sync_regcache(struct jlt4013a *ctx)
+{
+	int ret;
+
+	regcache_cache_only(ctx->regmap, false);
+	regcache_mark_dirty(ctx->regmap);
+
+	ret = regcache_sync(ctx->regmap);
+	if (ret)
+		return ret;
+
+	return st7701s_select_bank(ctx, ST7701S_CN2BKxSEL_NONE);
+}
+
+/*
+ * Writes a batch of registers at runtime through the regmap, so that they
+ * are cached and survive a power cycle. While the panel is off they are only
+ * cached. Blocks are sent grouped by bank, starting with the bank that is
+ * selected, so that each bank is selected at most once. The bank is left at
+ * none, where the command 1 set is available again.
+ */
+static int st7701s_write_regs(struct jlt4013a *ctx,
+			      const struct st7701s_reg *regs, unsigned int n)
+{
+	DECLARE_BITMAP(done, JLT4013A_SHADOW_REGS) = {};
+	const struct st7701s_reg *reg;
+	u8 bank = ctx->shadow.bank;
+	unsigned int i;
+	int ret;
+
+	if (n > JLT4013A_SHADOW_REGS)
+		return -E2BIG;
+
+	do {
+		u8 next = ST7701S_BANK_UNKNOWN;
+
+		for (i = 0; i < n; i++) {
+			reg = &regs[i];
+			if (test_bit(i, done))
+				continue;
+
+			if (reg->bank != bank) {
+				if (next == ST7701S_BANK_UNKNOWN)
+					next = reg->bank;
+				continue;
+			}
+
+			__set_bit(i, done);
+
+			ST7701S_TRY(ret, regmap_bulk_write(
+						 ctx->regmap,
+						 st7701s_reg(reg->bank, reg->cmd, 0),
+						 reg->data, reg->len));
+		}
+
+		bank = next;
+	} while (bank != ST7701S_BANK_UNKNOWN);
+
+	if (ctx->state == JLT4013A_OFF)
+		return 0;
+
+	ST7701S_TRY(ret, st7701s_select_bank(ctx, ST7701S_CN2BKxSEL_NONE));
+	ST7701S_TRY(ret, st7701s_flush(ctx));
+	return 0;
+}
+
+static inline struct jlt4013a *panel_to_jlt4013a(struct drm_panel *panel)
+{
+	return container_of(panel, struct jlt4013a, panel);
+}
+
+static void jlt4013a_set_state(struct jlt4013a *ctx,
+			       enum jlt4013a_state state)
+{
+	lockdep_assert_held(&ctx->lock);
+
+	if (state == ctx->state)
+		return;
+
+	ctx->transitions[ctx->state][state]++;
+	ctx->state = state;
+}
+
+/* Awake with all registers programmed, whether displaying or not */
+static bool jlt4013a_is_initialized(struct jlt4013a *ctx)
+{
+	return (ctx->state == JLT4013A_INITIALIZED ||
+		ctx->state == JLT4013A_DISPLAYING) &&
+	       !READ_ONCE(ctx->supply_lost);
+}
+
+static void jlt4013a_power_off(struct jlt4013a *ctx)
+{
+	ctx->handoff = false;
+	st7701s_shadow_reset(ctx, ST7701S_BANK_UNKNOWN);
+	regcache_cache_only(ctx->regmap, true);
+
+	if (ctx->state == JLT4013A_OFF)
+		return;
+
+	regulator_disable(ctx->supply);
+	jlt4013a_set_state(ctx, JLT4013A_OFF);
+}
+
+/*
+ * The bootloader may already have brought the panel up to show a splash
+ * screen. If the device tree says so, the supply is on and the panel reports
+ * that it is awake and displaying, that state is taken over as is and the
+ * first bring-up is skipped.
+ */
+static int jlt4013a_adopt_boot_state(struct jlt4013a *ctx)
+{
+	struct device *dev = &ctx->spi->dev;
+	u8 mode;
+	int ret;
+
+	if (!device_property_read_bool(dev, "jinglitai,boot-initialized"))
+		return 0;
+
+	if (regulator_is_enabled(ctx->supply) <= 0)
+		return 0;
+
+	/*
+	 * Bits 1 and 0 of RDDPM always read as 0, so 0xFF means there is no
+	 * readback path on this board and only the device tree is trusted.
+	 * A MISO that floats low reads 0x00 instead, which looks like a panel
+	 * that is off and only costs a full init here.
+	 */
+	ret = st7701s_read(ctx, ST7701S_RDDPM, &mode);
+	if (!ret && mode != 0xFF &&
+	    (mode & (ST7701S_RDDPM_SLPOUT | ST7701S_RDDPM_DISPON)) !=
+		    (ST7701S_RDDPM_SLPOUT | ST7701S_RDDPM_DISPON)) {
+		dev_info(dev,
+			 "Jinglitai JLT4013A: Panel is not on (power mode %02x), doing a full init\n",
+			 mode);
+		return 0;
+	}
+
+	ret = regulator_enable(ctx->supply);
+	if (ret)
+		return ret;
+
+	ctx->state = JLT4013A_DISPLAYING;
+	ctx->handoff = true;
+
+	dev_info(dev, "Jinglitai JLT4013A: Taking over panel from bootloader\n");
+	return 0;
+}
+
+/*
+ * Any event that may have dropped the supply below what the panel needs to
+ * keep its registers invalidates them, so the next bring-up does a full init.
+ * This runs from inside regulator calls made under ctx->lock, so it only
+ * raises a flag.
+ */
+static int jlt4013a_supply_event(struct notifier_block *nb,
+				 unsigned long event, void *data)
+{
+	struct jlt4013a *ctx = container_of(nb, struct jlt4013a, supply_nb);
+
+	if (event & (REGULATOR_EVENT_DISABLE | REGULATOR_EVENT_FORCE_DISABLE |
+		     REGULATOR_EVENT_UNDER_VOLTAGE))
+		WRITE_ONCE(ctx->supply_lost, true);
+
+	return NOTIFY_OK;
+}
+
+static int jlt4013a_sleep(struct jlt4013a *ctx)
+{
+	int ret;
+
+	jlt4013a_phase_begin(ctx, JLT4013A_PHASE_SLEEP_IN);
+	ret = 0;
+	if (ctx->state == JLT4013A_DISPLAYING)
+		ret = st7701s_queue(ctx, ST7701S_DISPOFF, NULL, 0);
+	if (!ret)
+		ret = st7701s_write(ctx, ST7701S_SLPIN, NULL, 0);
+	jlt4013a_phase_end(ctx, JLT4013A_PHASE_SLEEP_IN);
+	if (ret)
+		return ret;
+
+	jlt4013a_set_state(ctx, JLT4013A_SLEEPING);
+	ctx->sleep_start = ktime_get();
+	return 0;
+}
+
+/* Sends what differs from the profile, returns the number of blocks sent */
+static int jlt4013a_apply_delta(struct jlt4013a *ctx)
+{
+	int n, ret;
+
+	n = st7701s_run_delta(ctx, ctx->profile, ctx->profile_len);
+	if (n < 0)
+		return n;
+
+	ret = jlt4013a_sync_regcache(ctx);
+	return ret ? ret : n;
+}
+
+static int jlt4013a_wake(struct jlt4013a *ctx)
+{
+	s64 asleep = ktime_us_delta(ktime_get(), ctx->sleep_start);
+	int ret;
+
+	jlt4013a_phase_begin(ctx, JLT4013A_PHASE_WAKE_SLEEP_OUT);
+	if (asleep < ctx->timings.sleep_in)
+		fsleep(ctx->timings.sleep_in - asleep);
+
+	ret = st7701s_write(ctx, ST7701S_SLPOUT, NULL, 0);
+	if (!ret)
+		fsleep(ctx->timings.sleep_out);
+	jlt4013a_phase_end(ctx, JLT4013A_PHASE_WAKE_SLEEP_OUT);
+	if (ret)
+		return ret;
+
+	/*
+	 * Registers survive sleep, so only what differs from the profile is
+	 * sent. That is usually nothing, but after a take-over from the
+	 * bootloader the shadow is empty and the whole profile is applied.
+	 */
+	jlt4013a_phase_begin(ctx, JLT4013A_PHASE_WAKE_DELTA);
+	ret = jlt4013a_apply_delta(ctx);
+	jlt4013a_phase_end(ctx, JLT4013A_PHASE_WAKE_DELTA);
+	if (ret < 0)
+		return ret;
+	dev_dbg(ctx->panel.dev,
+		"Jinglitai JLT4013A: %d registers re-applied on wake\n", ret);
+
+	jlt4013a_set_state(ctx, JLT4013A_INITIALIZED);
+	return 0;
+}
+
+static int jlt4013a_bring_up(struct jlt4013a *ctx)
+{
+	ktime_t start;
+	int ret;
+
+	if (ctx->handoff) {
+		ctx->handoff = false;
+		return 0;
+	}
+
+	/*
+	 * Still on from before a seamless switch, the new mode only needs the
+	 * registers that differ. The pixel clock follows from the CRTC.
+	 */
+	if (jlt4013a_is_initialized(ctx)) {
+		jlt4013a_phase_begin(ctx, JLT4013A_PHASE_SWITCH);
+		ret = jlt4013a_apply_delta(ctx);
+		jlt4013a_phase_end(ctx, JLT4013A_PHASE_SWITCH);
+		if (ret >= 0) {
+			if (ctx->mode_changed)
+				ctx->switches++;
+			return 0;
+		}
+
+		jlt4013a_power_off(ctx);
+	}
+
+	/* A panel that kept its supply only needs to be woken up */
+	if (ctx->state == JLT4013A_SLEEPING) {
+		if (!READ_ONCE(ctx->supply_lost) && !jlt4013a_wake(ctx))
+			return 0;
+
+		jlt4013a_power_off(ctx);
+	}
+
+	/* Enable power supply */
+
+	start = ktime_get();
+	jlt4013a_phase_begin(ctx, JLT4013A_PHASE_POWER);
+	ret = regulator_enable(ctx->supply);
+	if (ret) {
+		jlt4013a_phase_end(ctx, JLT4013A_PHASE_POWER);
+		pr_err("Jinglitai JLT4013A: Failed to enable power supply\n");
+		return ret;
+	}
+	WRITE_ONCE(ctx->supply_lost, false);
+	jlt4013a_set_state(ctx, JLT4013A_POWERED);
+	fsleep(ctx->timings.power_on);
+	jlt4013a_phase_end(ctx, JLT4013A_PHASE_POWER);
+
+	/* Reset routine */
+	jlt4013a_phase_begin(ctx, JLT4013A_PHASE_RESET);
+	gpiod_set_value(ctx->reset, 1);
+	fsleep(ctx->timings.reset_assert);
+	gpiod_set_value(ctx->reset, 0);
+	fsleep(ctx->timings.reset_release);
+	jlt4013a_phase_end(ctx, JLT4013A_PHASE_RESET);
+
+	st7701s_shadow_reset(ctx, ST7701S_CN2BKxSEL_NONE);
+
+	/* Initialization routine */
+
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+	st7701s_pipeline_begin(ctx);
+
+	jlt4013a_phase_begin(ctx, JLT4013A_PHASE_SLEEP_OUT);
+	ret = st7701s_write(ctx, ST7701S_SLPOUT, NULL, 0);
+	if (!ret)
+		ret = st7701s_delay(ctx, ctx->timings.sleep_out);
+	jlt4013a_phase_end(ctx, JLT4013A_PHASE_SLEEP_OUT);
+	if (ret)
+		goto err_power_off;
+
+	ret = st7701s_run_sequence(ctx, ctx->profile, ctx->profile_len);
+	if (ret)
+		goto err_power_off;
+
+	jlt4013a_phase_begin(ctx, JLT4013A_PHASE_REGCACHE);
+	ret = jlt4013a_sync_regcache(ctx);
+	jlt4013a_phase_end(ctx, JLT4013A_PHASE_REGCACHE);
+	if (ret)
+		goto err_power_off;
+
+	ret = st7701s_pipeline_end(ctx);
+	if (ret)
+		goto err_power_off;
+
+	jlt4013a_set_state(ctx, JLT4013A_INITIALIZED);
+	jlt4013a_phase_record(ctx, JLT4013A_PHASE_TOTAL,
+			      ktime_us_delta(ktime_get(), start));
+
+	dev_dbg(ctx->panel.dev,
+		"Jinglitai JLT4013A: Panel is initialized, %u SPI messages, %u bytes, %llu us on the bus\n",
+		ctx->stats.messages, ctx->stats.bytes,
+		div_u64(ctx->stats.bus_ns, NSEC_PER_USEC));
+
+	return 0;
+
+err_power_off:
+	pr_err("Jinglitai JLT4013A: Failed to initialize panel: %d\n", ret);
+	st7701s_pipeline_discard(ctx);
+	jlt4013a_power_off(ctx);
+	return ret;
+}
+
+static void jlt4013a_bringup_work(struct work_struct *work)
+{
+	struct jlt4013a *ctx =
+		container_of(work, struct jlt4013a, bringup_work);
+
+	mutex_lock(&ctx->lock);
+	ctx->bringup_ret = jlt4013a_bring_up(ctx);
+	mutex_unlock(&ctx->lock);
+	complete_all(&ctx->bringup_done);
+}
+
+static int jlt4013a_build_profile(struct jlt4013a *ctx)
+{
+	const struct jlt4013a_desc *desc = ctx->desc;
+
+	if (ctx->seq_len + 3 > JLT4013A_MAX_SEQS)
+		return -EINVAL;
+
+	ctx->profile[0] = ctx->flip ? jlt4013a_scan_flipped_seq :
+				      jlt4013a_scan_normal_seq;
+	ctx->profile[1] = desc->mode_seqs[ctx->mode];
+	memcpy(&ctx->profile[2], ctx->seq, ctx->seq_len * sizeof(*ctx->seq));
+	ctx->profile[ctx->seq_len + 2] = ctx->format->seq;
+	ctx->profile_len = ctx->seq_len + 3;
+
+	return 0;
+}
+
+/*
+ * Panels have no mode_set hook, but prepare runs from the commit of the new
+ * state, where the CRTC already holds the mode. The closest mode of the
+ * descriptor is picked, as the CRTC may have rounded the clock. Returns
+ * whether that changed the mode.
+ */
+static bool jlt4013a_select_mode(struct jlt4013a *ctx)
+{
+	const struct jlt4013a_desc *desc = ctx->desc;
+	struct drm_connector *connector = ctx->connector;
+	const struct drm_display_mode *mode, *m;
+	unsigned int i, best = 0;
+
+	if (!connector || !connector->state || !connector->state->crtc)
+		return false;
+
+	mode = &connector->state->crtc->state->adjusted_mode;
+
+	for (i = 0; i < desc->num_modes; i++) {
+		m = &desc->modes[i];
+		if (m->hdisplay != mode->hdisplay ||
+		    m->vdisplay != mode->vdisplay ||
+		    m->htotal != mode->htotal || m->vtotal != mode->vtotal)
+			continue;
+
+		if (abs(m->clock - mode->clock) <
+		    abs(desc->modes[best].clock - mode->clock))
+			best = i;
+	}
+
+	if (best == ctx->mode)
+		return false;
+
+	ctx->mode = best;
+	jlt4013a_build_profile(ctx);
+
+	return true;
+}
+
+/*
+ * Power-up, reset and the init sequence always run from a work item, so that
+ * probe can start them early and prepare does not have to block on them. A
+ * runtime PM reference is held from here until unprepare.
+ */
+static int jlt4013a_start_bring_up(struct jlt4013a *ctx)
+{
+	struct device *dev = &ctx->spi->dev;
+	bool changed;
+	int ret;
+
+	/* Runtime suspend takes the lock, so it must not be waited on with it */
+	ret = pm_runtime_resume_and_get(dev);
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&ctx->lock);
+
+	if (ctx->bringup_queued) {
+		/*
+		 * A failed bring-up is retried, as no unprepare follows a
+		 * failed prepare. One that probe started, or took over from
+		 * the bootloader, had no connector yet and used the first
+		 * mode, so it runs again to apply the delta if the modeset
+		 * wants another. It already holds a runtime PM reference.
+		 */
+		changed = jlt4013a_select_mode(ctx);
+		if (!changed &&
+		    !(completion_done(&ctx->bringup_done) && ctx->bringup_ret)) {
+			ctx->redundant[JLT4013A_PREPARE]++;
+			ret = 0;
+			goto err_put;
+		}
+
+		pm_runtime_put_noidle(dev);
+		goto queue;
+	}
+
+	if (ctx->cycling) {
+		ret = -EBUSY;
+		goto err_put;
+	}
+
+	/* Back within seamless_ms, the reference unprepare left is not needed */
+	if (ctx->sleep_pending) {
+		ctx->sleep_pending = false;
+		pm_runtime_put_noidle(dev);
+	}
+
+	ctx->bringup_queued = true;
+	changed = jlt4013a_select_mode(ctx);
+queue:
+	ctx->mode_changed = changed;
+	reinit_completion(&ctx->bringup_done);
+	queue_work(system_unbound_wq, &ctx->bringup_work);
+
+	mutex_unlock(&ctx->lock);
+	return 0;
+
+err_put:
+	mutex_unlock(&ctx->lock);
+	pm_runtime_put_autosuspend(dev);
+	return ret;
+}
+
+static int jlt4013a_wait_bring_up(struct jlt4013a *ctx)
+{
+	if (!ctx->bringup_queued)
+		return 0;
+
+	wait_for_completion(&ctx->bringup_done);
+	return ctx->bringup_ret;
+}
+
+static int jlt4013a_prepare(struct drm_panel *panel)
+{
+	struct jlt4013a *ctx = panel_to_jlt4013a(panel);
+	int ret;
+
+	ret = jlt4013a_start_bring_up(ctx);
+	if (ret || async_prepare)
+		return ret;
+
+	return jlt4013a_wait_bring_up(ctx);
+}
+
+/* Puts the panel to sleep, or cuts its supply when that is not possible */
+static void jlt4013a_park(struct jlt4013a *ctx)
+{
+	if (!sleep_on_unprepare || !jlt4013a_is_initialized(ctx) ||
+	    jlt4013a_sleep(ctx))
+		jlt4013a_power_off(ctx);
+}
+
+/*
+ * A disable and unprepare that are not followed by prepare and enable within
+ * seamless_ms end up here, and do what they skipped.
+ */
+static void jlt4013a_blank_work(struct work_struct *work)
+{
+	struct jlt4013a *ctx =
+		container_of(to_delayed_work(work), struct jlt4013a, blank_work);
+	struct device *dev = &ctx->spi->dev;
+	bool put;
+
+	mutex_lock(&ctx->lock);
+
+	if (ctx->blank_pending && ctx->state == JLT4013A_DISPLAYING &&
+	    !st7701s_write(ctx, ST7701S_DISPOFF, NULL, 0))
+		jlt4013a_set_state(ctx, JLT4013A_INITIALIZED);
+	ctx->blank_pending = false;
+
+	put = ctx->sleep_pending;
+	if (ctx->sleep_pending) {
+		ctx->sleep_pending = false;
+		jlt4013a_park(ctx);
+	}
+
+	mutex_unlock(&ctx->lock);
+
+	if (put) {
+		pm_runtime_mark_last_busy(dev);
+		pm_runtime_put_autosuspend(dev);
+	}
+}
+
+/*
+ * The panel is only put to sleep here. Runtime PM cuts the supply once it
+ * has stayed unprepared for the autosuspend delay, so a prepare within that
+ * window only has to wake it up.
+ */
+static int jlt4013a_unprepare(struct drm_panel *panel)
+{
+	struct jlt4013a *ctx = panel_to_jlt4013a(panel);
+	struct device *dev = &ctx->spi->dev;
+	int ret;
+
+	ret = jlt4013a_wait_bring_up(ctx);
+
+	mutex_lock(&ctx->lock);
+
+	if (!ctx->bringup_queued) {
+		ctx->redundant[JLT4013A_UNPREPARE]++;
+		mutex_unlock(&ctx->lock);
+		return 0;
+	}
+
+	ctx->bringup_queued = false;
+
+	/* The runtime PM reference goes to the blank work */
+	if (!ret && seamless_ms && jlt4013a_is_initialized(ctx)) {
+		ctx->sleep_pending = true;
+		mod_delayed_work(system_wq, &ctx->blank_work,
+				 msecs_to_jiffies(seamless_ms));
+		mutex_unlock(&ctx->lock);
+		return 0;
+	}
 
-struct jlt4013a {
-	struct drm_panel panel;
-	struct spi_device *spi;
-	struct gpio_desc *reset;
-	struct gpio_desc *dcx;
-	struct regulator *supply;
-};
+	if (ret)
+		jlt4013a_power_off(ctx);
+	else
+		jlt4013a_park(ctx);
+
+	mutex_unlock(&ctx->lock);
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+	return 0;
+}
 
-static int st7701s_spi_write(struct jlt4013a *ctx, u8 data)
+static int jlt4013a_get_modes(struct drm_panel *panel,
+			      struct drm_connector *connector)
 {
-	struct spi_transfer xfer = {};
-	struct spi_message msg;
+	struct jlt4013a *ctx = panel_to_jlt4013a(panel);
+	const struct jlt4013a_desc *desc = ctx->desc;
+	struct drm_display_mode *mode;
+	unsigned int i;
+
+	/*
+	 * Kept for jlt4013a_select_mode(). The connector belongs to the DRM
+	 * device, not to the panel, and is only looked at from prepare. That
+	 * device probes its connector, and so sets the pointer, before its
+	 * first modeset, and it stops calling prepare before it frees the
+	 * connector. A DRM device bound later replaces it the same way.
+	 */
+	mutex_lock(&ctx->lock);
+	ctx->connector = connector;
+	mutex_unlock(&ctx->lock);
+
+	for (i = 0; i < desc->num_modes; i++) {
+		mode = drm_mode_duplicate(connector->dev, &desc->modes[i]);
+		if (mode == NULL) {
+			dev_err(panel->dev,
+				"Jinglitai JLT4013A: Failed to add mode %ux%u\n",
+				desc->modes[i].hdisplay,
+				desc->modes[i].vdisplay);
+			return -EAGAIN;
+		}
+
+		drm_mode_set_name(mode);
+
+		mode->type = DRM_MODE_TYPE_DRIVER;
+		if (i == 0)
+			mode->type |= DRM_MODE_TYPE_PREFERRED;
+		mode->width_mm = desc->width_mm;
+		mode->height_mm = desc->height_mm;
+
+		drm_mode_probed_add(connector, mode);
+	}
 
-	spi_message_init(&msg);
+	connector->display_info.width_mm = desc->width_mm;
+	connector->display_info.height_mm = desc->height_mm;
+	connector->display_info.bpc = ctx->format->bpc;
+	connector->display_info.bus_flags = desc->bus_flags;
 
-	xfer.tx_buf = &data;
-	xfer.bits_per_word = 8;
-	xfer.len = sizeof(data);
+	drm_display_info_set_bus_formats(&connector->display_info,
+					 &ctx->format->bus_format, 1);
 
-	spi_message_add_tail(&xfer, &msg);
-	return spi_sync(ctx->spi, &msg);
+	/*
+	 * Before 6.1 this is the only way for the orientation to reach the
+	 * connector. Later kernels ask .get_orientation, but only from drivers
+	 * that call drm_connector_set_orientation_from_panel(), so it is set
+	 * here on those as well.
+	 */
+	drm_connector_set_panel_orientation(connector, ctx->orientation);
+
+	return desc->num_modes;
 }
 
-static int st7701s_write_command(struct jlt4013a *ctx, u8 cmd)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,1,0)
+static enum drm_panel_orientation
+jlt4013a_get_orientation(struct drm_panel *panel)
 {
-	pr_info("Jinglitai JLT4013A: Writing SPI command with value %x\n", cmd);
-
-	gpiod_set_value(ctx->dcx, 0);
+	struct jlt4013a *ctx = panel_to_jlt4013a(panel);
 
-	return st7701s_spi_write(ctx, cmd);
+	return ctx->orientation;
 }
+#endif
 
-static int st7701s_write_data(struct jlt4013a *ctx, u8 cmd)
+/*
+ * Blanking only toggles DISPON/DISPOFF, the panel stays out of sleep with
+ * its registers programmed. The drm_panel core enables the backlight after
+ * enable and disables it before disable, so it never lights up garbage.
+ */
+static int jlt4013a_display_on(struct jlt4013a *ctx)
 {
-	pr_info("Jinglitai JLT4013A: Writing SPI data with value %x\n", cmd);
+	int ret;
+
+	lockdep_assert_held(&ctx->lock);
 
-	gpiod_set_value(ctx->dcx, 1);
+	/* Enabled without a successful prepare */
+	if (ctx->state != JLT4013A_INITIALIZED)
+		return -EINVAL;
+
+	jlt4013a_phase_begin(ctx, JLT4013A_PHASE_DISPLAY_ON);
+	ret = st7701s_write(ctx, ST7701S_DISPON, NULL, 0);
+	if (!ret)
+		fsleep(ctx->timings.display_on);
+	jlt4013a_phase_end(ctx, JLT4013A_PHASE_DISPLAY_ON);
+	if (ret)
+		return ret;
 
-	return st7701s_spi_write(ctx, cmd);
+	jlt4013a_set_state(ctx, JLT4013A_DISPLAYING);
+	return 0;
 }
 
-static inline struct jlt4013a *panel_to_jlt4013a(struct drm_panel *panel)
+/*
+ * Sends the whole profile again, without a reset or a power cycle, for a
+ * panel whose registers can no longer be trusted. Runtime writes come back
+ * from the register cache.
+ */
+static int jlt4013a_recover(struct jlt4013a *ctx, u8 mode)
 {
-	return container_of(panel, struct jlt4013a, panel);
+	ktime_t start = ktime_get();
+	int ret;
+
+	/* The selected bank may be scrambled too, so it is always selected */
+	st7701s_shadow_reset(ctx, ST7701S_BANK_UNKNOWN);
+	ret = st7701s_select_bank(ctx, ST7701S_CN2BKxSEL_NONE);
+	if (ret)
+		goto out;
+
+	if (!(mode & ST7701S_RDDPM_SLPOUT)) {
+		ret = st7701s_write(ctx, ST7701S_SLPOUT, NULL, 0);
+		if (ret)
+			goto out;
+		fsleep(ctx->timings.sleep_out);
+	}
+
+	ret = st7701s_run_sequence(ctx, ctx->profile, ctx->profile_len);
+	if (ret)
+		goto out;
+
+	ret = jlt4013a_sync_regcache(ctx);
+	if (ret)
+		goto out;
+
+	ret = st7701s_write(ctx, ST7701S_DISPON, NULL, 0);
+
+out:
+	/* The profile times its own phases, so this is timed like total */
+	jlt4013a_phase_record(ctx, JLT4013A_PHASE_ESD_RECOVER,
+			      ktime_us_delta(ktime_get(), start));
+	return ret;
 }
 
-static int jlt4013a_prepare(struct drm_panel *panel)
+/*
+ * Interference can knock the panel out of sleep-out or display-on, or
+ * scramble its registers, while everything upstream keeps running. The power
+ * mode is read back every esd_interval_ms while displaying, and one that is
+ * wrong JLT4013A_ESD_BAD_READS times in a row is fixed in place instead of
+ * waiting for a DPMS cycle.
+ */
+static void jlt4013a_esd_work(struct work_struct *work)
 {
+	struct jlt4013a *ctx =
+		container_of(to_delayed_work(work), struct jlt4013a, esd_work);
+	struct jlt4013a_esd_stats *esd = &ctx->esd;
+	struct device *dev = &ctx->spi->dev;
+	u8 mode, after;
 	int ret;
-	struct jlt4013a *ctx = panel_to_jlt4013a(panel);
 
-	/* Enable power supply */
+	mutex_lock(&ctx->lock);
+
+	if (ctx->state != JLT4013A_DISPLAYING || ctx->blank_pending ||
+	    esd->stopped)
+		goto out;
+
+	jlt4013a_phase_begin(ctx, JLT4013A_PHASE_ESD_CHECK);
+	ret = st7701s_read(ctx, ST7701S_RDDPM, &mode);
+	jlt4013a_phase_end(ctx, JLT4013A_PHASE_ESD_CHECK);
+	esd->checks++;
 
-	pr_info("Jinglitai JLT4013A: Trying to enable power supply\n");
-	ret = regulator_enable(ctx->supply);
 	if (ret) {
-		pr_err("Jinglitai JLT4013A: Failed to enable power supply\n");
+		esd->read_errors++;
+		goto requeue;
+	}
+
+	esd->last_mode = mode;
+
+	/* See jlt4013a_adopt_boot_state(), there is nothing to check against */
+	if (mode == 0xFF) {
+		esd->stopped = true;
+		dev_info(dev,
+			 "Jinglitai JLT4013A: No readback, health check stopped\n");
+		goto out;
+	}
+
+	if ((mode & (ST7701S_RDDPM_SLPOUT | ST7701S_RDDPM_DISPON)) ==
+	    (ST7701S_RDDPM_SLPOUT | ST7701S_RDDPM_DISPON)) {
+		esd->bad_streak = 0;
+		goto requeue;
+	}
+
+	esd->bad_state++;
+	if (++esd->bad_streak < JLT4013A_ESD_BAD_READS)
+		goto requeue;
+	esd->bad_streak = 0;
+
+	dev_warn(dev,
+		 "Jinglitai JLT4013A: Power mode %02x, re-initializing panel\n",
+		 mode);
+
+	ret = jlt4013a_recover(ctx, mode);
+	if (ret) {
+		esd->failed_recoveries++;
+		dev_err(dev, "Jinglitai JLT4013A: Failed to recover panel: %d\n",
+			ret);
+		goto requeue;
+	}
+	esd->recoveries++;
+
+	/*
+	 * A readback that a recovery does not change does not come from the
+	 * panel, e.g. a MISO that floats low and always reads 0x00. Checking
+	 * it again would only re-send the profile every interval.
+	 */
+	if (!st7701s_read(ctx, ST7701S_RDDPM, &after) && after == mode) {
+		esd->stopped = true;
+		dev_warn(dev,
+			 "Jinglitai JLT4013A: Power mode still %02x after recovery, health check stopped\n",
+			 mode);
+		goto out;
+	}
+
+requeue:
+	if (esd_interval_ms)
+		mod_delayed_work(system_wq, &ctx->esd_work,
+				 msecs_to_jiffies(esd_interval_ms));
+out:
+	mutex_unlock(&ctx->lock);
+}
+
+static int jlt4013a_enable(struct drm_panel *panel)
+{
+	struct jlt4013a *ctx = panel_to_jlt4013a(panel);
+	int ret;
+
+	ret = jlt4013a_wait_bring_up(ctx);
+	if (ret)
 		return ret;
+
+	mutex_lock(&ctx->lock);
+
+	if (ctx->blank_pending && ctx->state == JLT4013A_DISPLAYING) {
+		/* The other half of a seamless switch, the panel never went dark */
+		ctx->blank_pending = false;
+	} else if (ctx->state == JLT4013A_DISPLAYING) {
+		ctx->redundant[JLT4013A_ENABLE]++;
+	} else {
+		ret = jlt4013a_display_on(ctx);
+		if (ret)
+			pr_err("Jinglitai JLT4013A: Failed to turn display on: %d\n",
+			       ret);
 	}
-	msleep(120);
-	pr_info("Jinglitai JLT4013A: Enabled power supply\n");
 
-	/* Reset routine */
-	pr_info("Jinglitai JLT4013A: Doing the reset routine\n");
-	gpiod_set_value(ctx->reset, 1);
-	msleep(120);
-	gpiod_set_value(ctx->reset, 0);
-	msleep(120); // Sleep mandated by the datasheet
-	pr_info("Jinglitai JLT4013A: Panel is reset\n");
+	if (!ret && esd_interval_ms && !ctx->esd.stopped)
+		mod_delayed_work(system_wq, &ctx->esd_work,
+				 msecs_to_jiffies(esd_interval_ms));
 
-	/* Initialization routine */
-	pr_info("Jinglitai JLT4013A: Doing the initialization routine\n");
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_SLPOUT));
-	msleep(120);
-
-	/* BK0 */
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_CN2BKxSEL));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x77));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x01));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x10));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_PORCTRL));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x11));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x02));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_INVSET));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x31));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x03));
-
-	/* Something strange */
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xCC));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x10));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_PVGAMCTRL));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x40));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x01));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x46));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x0D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x13));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x09));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x05));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x09));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x09));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x1B));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x07));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x15));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x12));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x4C));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x10));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xC8));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_NVGAMCTRL));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x40));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x02));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x86));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x0D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x13));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x09));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x05));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x09));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x09));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x1F));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x07));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x15));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x12));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x15));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x19));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x08));
-
-	/* BK1 */
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_CN2BKxSEL));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x77));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x01));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x11));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_VRHS));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x50));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_VCOM));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x68));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_VGHSS));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x07));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_TESTCMD));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x80));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_VGLS));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x47));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_PWCTRL1));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x85));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_PWCTRL2));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x21));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_PWCTRL3));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x10));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_SPD1));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x21));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x36));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_SPD2));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x78));
-
-	msleep(120);
-
-	/* Something strange */
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xE0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x02));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xE1));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x08));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x0A));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x07));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x09));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x33));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x33));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xE2));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xE3));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x33));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x33));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xE4));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x44));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x44));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xE5));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x0E));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x2D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x10));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x2D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x0A));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x2D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x0C));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x2D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xE6));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x33));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x33));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xE7));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x44));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x44));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xE8));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x0D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x2D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x0F));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x2D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x09));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x2D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x0B));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x2D));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xA0));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xEB));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x02));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x01));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xE4));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xE4));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x44));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x40));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xEC));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x02));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x01));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, 0xED));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xAB));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x89));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x76));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x54));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x01));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xFF));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xFF));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xFF));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xFF));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xFF));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xFF));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x10));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x45));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x67));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x98));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0xBA));
-
-	/* BK disable */
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_CN2BKxSEL));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x77));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x01));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x00));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_COLMOD));
-	ST7701S_TRY(ret, st7701s_write_data(ctx, 0x77));
-
-	ST7701S_TRY(ret, st7701s_write_command(ctx, ST7701S_DISPON));
-
-	msleep(120);
-
-	pr_info("Jinglitai JLT4013A: Panel is initialized\n");
+	mutex_unlock(&ctx->lock);
 	return ret;
 }
 
-static int jlt4013a_unprepare(struct drm_panel *panel)
+static int jlt4013a_disable(struct drm_panel *panel)
 {
 	struct jlt4013a *ctx = panel_to_jlt4013a(panel);
+	int ret = 0;
+
+	mutex_lock(&ctx->lock);
+
+	if (ctx->state != JLT4013A_DISPLAYING || ctx->blank_pending) {
+		ctx->redundant[JLT4013A_DISABLE]++;
+		goto out;
+	}
 
-	int ret = regulator_disable(ctx->supply);
+	/* The backlight is already off, DISPOFF waits for a possible enable */
+	if (seamless_ms) {
+		ctx->blank_pending = true;
+		mod_delayed_work(system_wq, &ctx->blank_work,
+				 msecs_to_jiffies(seamless_ms));
+		goto out;
+	}
+
+	ret = st7701s_write(ctx, ST7701S_DISPOFF, NULL, 0);
+	if (ret) {
+		pr_err("Jinglitai JLT4013A: Failed to turn display off: %d\n",
+		       ret);
+		goto out;
+	}
+
+	jlt4013a_set_state(ctx, JLT4013A_INITIALIZED);
+out:
+	mutex_unlock(&ctx->lock);
 	return ret;
 }
 
-static const struct drm_display_mode jlt4013a_default_display_mode = {
-	.clock = 27000,
-	.hdisplay = 480,
-	.hsync_start = 480 + 32, // 512
-	.hsync_end = 480 + 32 + 11, // 523
-	.htotal = 480 + 32 + 11 + 2, // 525
-	.vdisplay = 800,
-	.vsync_start = 800 + 54, // 854
-	.vsync_end = 800 + 54 + 41, // 895
-	.vtotal = 800 + 54 + 41 + 33, // 928
-	.width_mm = 52,
-	.height_mm = 86,
+static int __maybe_unused jlt4013a_runtime_suspend(struct device *dev)
+{
+	struct jlt4013a *ctx = dev_get_drvdata(dev);
+
+	mutex_lock(&ctx->lock);
+	jlt4013a_power_off(ctx);
+	mutex_unlock(&ctx->lock);
+	return 0;
+}
+
+/* Power-up is left to the bring-up, which knows if a full init is needed */
+static int __maybe_unused jlt4013a_runtime_resume(struct device *dev)
+{
+	return 0;
+}
+
+/*
+ * System sleep goes through the runtime PM callbacks, so a panel left asleep
+ * by unprepare does not keep its supply on while the system is suspended.
+ * Without CONFIG_PM the macros are empty and the callbacks go unused.
+ */
+static const struct dev_pm_ops jlt4013a_pm_ops = {
+	SET_SYSTEM_SLEEP_PM_OPS(pm_runtime_force_suspend,
+				pm_runtime_force_resume)
+	SET_RUNTIME_PM_OPS(jlt4013a_runtime_suspend, jlt4013a_runtime_resume,
+			   NULL)
 };
 
-static int jlt4013a_get_modes(struct drm_panel *panel,
-			      struct drm_connector *connector)
+static const char *const st7701s_bus_names[] = {
+	[ST7701S_BUS_DCX] = "dcx",
+	[ST7701S_BUS_9BIT] = "9bit",
+	[ST7701S_BUS_9BIT_PACKED] = "9bit-packed",
+};
+
+/*
+ * Counters of the last init sequence, one "key: value" per line so that
+ * they can be compared between runs. The command stream itself is available
+ * from the jlt4013a_cmd tracepoint.
+ */
+static int jlt4013a_stats_show(struct seq_file *m, void *data)
 {
-	static const u32 bus_format = MEDIA_BUS_FMT_RGB888_1X24;
+	struct jlt4013a *ctx = m->private;
+	const struct jlt4013a_spi_stats *stats = &ctx->stats;
+
+	seq_printf(m, "bus: %s\n", st7701s_bus_names[ctx->bus]);
+	seq_printf(m, "state: %s\n", jlt4013a_state_names[READ_ONCE(ctx->state)]);
+	seq_printf(m, "messages: %u\n", stats->messages);
+	seq_printf(m, "bytes: %u\n", stats->bytes);
+	seq_printf(m, "dcx_writes: %u\n", stats->dcx_writes);
+	seq_printf(m, "bank_skips: %u\n", stats->bank_skips);
+	seq_printf(m, "delays: %u\n", stats->delays);
+	seq_printf(m, "delay_us: %llu\n", stats->delay_us);
+	seq_printf(m, "bus_us: %llu\n", div_u64(stats->bus_ns, NSEC_PER_USEC));
 
-	struct drm_display_mode *mode = drm_mode_duplicate(
-		connector->dev, &jlt4013a_default_display_mode);
-	if (mode == NULL) {
-		dev_err(panel->dev,
-			"Jinglitai JLT4013A: Failed to add default mode\n");
-		return -EAGAIN;
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(jlt4013a_stats);
+
+/*
+ * The current state, every transition taken since probe and the panel hooks
+ * that had nothing to do, e.g. a second prepare from a bridge.
+ */
+static int jlt4013a_state_show(struct seq_file *m, void *data)
+{
+	struct jlt4013a *ctx = m->private;
+	unsigned int from, to, i;
+
+	mutex_lock(&ctx->lock);
+
+	seq_printf(m, "state: %s\n", jlt4013a_state_names[ctx->state]);
+
+	for (from = 0; from < JLT4013A_NR_STATES; from++)
+		for (to = 0; to < JLT4013A_NR_STATES; to++)
+			if (ctx->transitions[from][to])
+				seq_printf(m, "%s -> %s: %u\n",
+					   jlt4013a_state_names[from],
+					   jlt4013a_state_names[to],
+					   ctx->transitions[from][to]);
+
+	for (i = 0; i < JLT4013A_NR_HOOKS; i++)
+		seq_printf(m, "redundant_%s: %u\n", jlt4013a_hook_names[i],
+			   ctx->redundant[i]);
+
+	seq_printf(m, "seamless_switches: %u\n", ctx->switches);
+
+	mutex_unlock(&ctx->lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(jlt4013a_state);
+
+static int jlt4013a_esd_show(struct seq_file *m, void *data)
+{
+	struct jlt4013a *ctx = m->private;
+	const struct jlt4013a_esd_stats *esd = &ctx->esd;
+
+	mutex_lock(&ctx->lock);
+
+	seq_printf(m, "interval_ms: %u\n", READ_ONCE(esd_interval_ms));
+	seq_printf(m, "checks: %u\n", esd->checks);
+	seq_printf(m, "read_errors: %u\n", esd->read_errors);
+	seq_printf(m, "bad_state: %u\n", esd->bad_state);
+	seq_printf(m, "bad_streak: %u\n", esd->bad_streak);
+	seq_printf(m, "recoveries: %u\n", esd->recoveries);
+	seq_printf(m, "failed_recoveries: %u\n", esd->failed_recoveries);
+	seq_printf(m, "last_mode: %02x\n", esd->last_mode);
+	seq_printf(m, "stopped: %d\n", esd->stopped);
+
+	mutex_unlock(&ctx->lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(jlt4013a_esd);
+
+static u32 jlt4013a_phase_p99(const struct jlt4013a_phase_stats *stats)
+{
+	u32 rank = DIV_ROUND_UP(stats->count * 99, 100);
+	u32 seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < JLT4013A_HIST_BUCKETS; i++) {
+		seen += stats->hist[i];
+		if (seen >= rank)
+			break;
+	}
+
+	return min(jlt4013a_hist_limit(i) - 1, stats->max_us);
+}
+
+static int jlt4013a_phases_show(struct seq_file *m, void *data)
+{
+	struct jlt4013a *ctx = m->private;
+	const struct jlt4013a_phase_stats *stats;
+	unsigned int i, j;
+
+	seq_printf(m, "%-16s %8s %10s %10s %10s %10s\n", "phase", "count",
+		   "min_us", "avg_us", "max_us", "p99_us");
+
+	for (i = 0; i < JLT4013A_PHASE_SEQ(ctx->profile_len); i++) {
+		stats = &ctx->phases[i];
+		if (!stats->count)
+			continue;
+		seq_printf(m, "%-16s %8u %10u %10llu %10u %10u\n",
+			   jlt4013a_phase_name(ctx, i),
+			   stats->count, stats->min_us,
+			   div_u64(stats->sum_us, stats->count), stats->max_us,
+			   jlt4013a_phase_p99(stats));
+	}
+
+	for (i = 0; i < JLT4013A_PHASE_SEQ(ctx->profile_len); i++) {
+		stats = &ctx->phases[i];
+		if (!stats->count)
+			continue;
+		seq_printf(m, "\n%s:\n", jlt4013a_phase_name(ctx, i));
+		for (j = 0; j < JLT4013A_HIST_BUCKETS; j++)
+			if (stats->hist[j])
+				seq_printf(m, "  < %10u us: %u\n",
+					   jlt4013a_hist_limit(j),
+					   stats->hist[j]);
 	}
 
-	drm_mode_set_name(mode);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(jlt4013a_phases);
 
-	mode->type = DRM_MODE_TYPE_PREFERRED | DRM_MODE_TYPE_DRIVER;
+/*
+ * Runs full power cycles back to back to fill the phase histograms. This is
+ * meant for a panel that no display pipeline is using: prepare is refused
+ * until the cycles are done.
+ */
+static void jlt4013a_cycle_work(struct work_struct *work)
+{
+	struct jlt4013a *ctx = container_of(work, struct jlt4013a, cycle_work);
+	struct device *dev = &ctx->spi->dev;
+	int ret;
 
-	connector->display_info.width_mm = mode->width_mm;
-	connector->display_info.height_mm = mode->height_mm;
-	connector->display_info.bpc = 8;
-	connector->display_info.bus_flags = DRM_BUS_FLAG_PIXDATA_DRIVE_POSEDGE;
+	ret = pm_runtime_resume_and_get(dev);
+	if (ret < 0)
+		goto out;
+
+	while (atomic_dec_if_positive(&ctx->cycles) >= 0) {
+		mutex_lock(&ctx->lock);
+		jlt4013a_power_off(ctx);
+		ret = jlt4013a_bring_up(ctx);
+		if (!ret)
+			ret = jlt4013a_display_on(ctx);
+		jlt4013a_power_off(ctx);
+		mutex_unlock(&ctx->lock);
+		if (ret)
+			break;
+	}
 
-	drm_mode_probed_add(connector, mode);
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+out:
+	atomic_set(&ctx->cycles, 0);
+	mutex_lock(&ctx->lock);
+	ctx->cycling = false;
+	mutex_unlock(&ctx->lock);
+}
 
-	drm_display_info_set_bus_formats(&connector->display_info, &bus_format,
-					 1);
+static int jlt4013a_cycle_get(void *data, u64 *val)
+{
+	struct jlt4013a *ctx = data;
 
-	return 1;
+	*val = atomic_read(&ctx->cycles);
+	return 0;
 }
 
-static int jlt4013a_enable(struct drm_panel *panel)
+/* Writing N starts N cycles with fresh histograms, writing 0 stops them */
+static int jlt4013a_cycle_set(void *data, u64 val)
 {
+	struct jlt4013a *ctx = data;
+
+	if (!val) {
+		atomic_set(&ctx->cycles, 0);
+		return 0;
+	}
+
+	mutex_lock(&ctx->lock);
+
+	if (ctx->bringup_queued || ctx->cycling) {
+		mutex_unlock(&ctx->lock);
+		return -EBUSY;
+	}
+
+	memset(ctx->phases, 0, sizeof(ctx->phases));
+	atomic_set(&ctx->cycles, min_t(u64, val, INT_MAX));
+	ctx->cycling = true;
+	queue_work(system_long_wq, &ctx->cycle_work);
+
+	mutex_unlock(&ctx->lock);
 	return 0;
 }
+DEFINE_DEBUGFS_ATTRIBUTE(jlt4013a_cycle_fops, jlt4013a_cycle_get,
+			 jlt4013a_cycle_set, "%llu\n");
 
-static int jlt4013a_disable(struct drm_panel *panel)
+static int jlt4013a_shadow_show(struct seq_file *m, void *data)
+{
+	struct jlt4013a *ctx = m->private;
+	const struct jlt4013a_shadow *shadow = &ctx->shadow;
+	const struct st7701s_reg *reg;
+	unsigned int i;
+
+	if (shadow->bank == ST7701S_BANK_UNKNOWN)
+		seq_puts(m, "bank: unknown\n");
+	else
+		seq_printf(m, "bank: %02x\n", shadow->bank);
+
+	for (i = 0; i < shadow->nregs; i++) {
+		reg = &shadow->regs[i];
+		seq_printf(m, "%02x %02x %*ph\n", reg->bank, reg->cmd,
+			   reg->len, reg->data);
+	}
+
+	return 0;
+}
+
+static int jlt4013a_shadow_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, jlt4013a_shadow_show, inode->i_private);
+}
+
+static int jlt4013a_parse_reg(char *line, struct st7701s_reg *reg)
 {
+	unsigned int i = 0;
+	char *tok;
+	u8 val;
+	int ret;
+
+	while ((tok = strsep(&line, " \t"))) {
+		if (!*tok)
+			continue;
+
+		ret = kstrtou8(tok, 16, &val);
+		if (ret)
+			return ret;
+
+		if (i == 0)
+			reg->bank = val;
+		else if (i == 1)
+			reg->cmd = val;
+		else if (i - 2 < ST7701S_MAX_PARAMS)
+			reg->data[i - 2] = val;
+		else
+			return -EINVAL;
+		i++;
+	}
+
+	if (i < 3 || reg->cmd == ST7701S_CN2BKxSEL)
+		return -EINVAL;
+
+	if (reg->bank != ST7701S_CN2BKxSEL_NONE &&
+	    (reg->bank < ST7701S_CN2BKxSEL_BK0 ||
+	     reg->bank > ST7701S_CN2BKxSEL_BK0 + 6))
+		return -EINVAL;
+
+	reg->len = i - 2;
 	return 0;
 }
 
+/*
+ * Takes lines of "<bank> <cmd> <param>..." in hex, as the shadow is shown,
+ * and writes them in one batch.
+ */
+static ssize_t jlt4013a_shadow_write(struct file *file, const char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	struct jlt4013a *ctx = ((struct seq_file *)file->private_data)->private;
+	struct st7701s_reg *regs;
+	unsigned int n = 0;
+	char *buf, *cur, *line;
+	int ret = 0;
+
+	buf = memdup_user_nul(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	regs = kcalloc(JLT4013A_SHADOW_REGS, sizeof(*regs), GFP_KERNEL);
+	if (!regs) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	cur = buf;
+	while ((line = strsep(&cur, "\n"))) {
+		line = strim(line);
+		if (!*line)
+			continue;
+
+		if (n == JLT4013A_SHADOW_REGS) {
+			ret = -E2BIG;
+			goto out;
+		}
+
+		ret = jlt4013a_parse_reg(line, &regs[n++]);
+		if (ret)
+			goto out;
+	}
+
+	/* A panel that is off only gets them cached */
+	mutex_lock(&ctx->lock);
+	if (ctx->state == JLT4013A_POWERED || ctx->cycling)
+		ret = -EBUSY;
+	else
+		ret = st7701s_write_regs(ctx, regs, n);
+	mutex_unlock(&ctx->lock);
+
+out:
+	kfree(regs);
+	kfree(buf);
+	return ret ? ret : count;
+}
+
+static const struct file_operations jlt4013a_shadow_fops = {
+	.owner = THIS_MODULE,
+	.open = jlt4013a_shadow_open,
+	.read = seq_read,
+	.write = jlt4013a_shadow_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void jlt4013a_debugfs_init(struct jlt4013a *ctx)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "jlt4013a-%s", dev_name(&ctx->spi->dev));
+	ctx->debugfs = debugfs_create_dir(name, NULL);
+
+	debugfs_create_file("stats", 0444, ctx->debugfs, ctx,
+			    &jlt4013a_stats_fops);
+	debugfs_create_file("phases", 0444, ctx->debugfs, ctx,
+			    &jlt4013a_phases_fops);
+	debugfs_create_file("shadow", 0644, ctx->debugfs, ctx,
+			    &jlt4013a_shadow_fops);
+	debugfs_create_file("state", 0444, ctx->debugfs, ctx,
+			    &jlt4013a_state_fops);
+	debugfs_create_file("esd", 0444, ctx->debugfs, ctx,
+			    &jlt4013a_esd_fops);
+	debugfs_create_file_unsafe("cycle", 0644, ctx->debugfs, ctx,
+				   &jlt4013a_cycle_fops);
+}
+
 static const struct drm_panel_funcs jlt4013afuncs = {
 	.prepare = jlt4013a_prepare,
 	.unprepare = jlt4013a_unprepare,
 	.get_modes = jlt4013a_get_modes,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,1,0)
+	.get_orientation = jlt4013a_get_orientation,
+#endif
 	.enable = jlt4013a_enable,
 	.disable = jlt4013a_disable,
 };
 
+static int jlt4013a_parse_firmware(struct device *dev,
+				   const struct firmware *fw,
+				   struct st7701s_seq *seq)
+{
+	const struct jlt4013a_fw_header *hdr = (const void *)fw->data;
+	const struct jlt4013a_fw_cmd *entry;
+	struct st7701s_cmd *cmds;
+	size_t off = sizeof(*hdr);
+	unsigned int i, count;
+
+	if (fw->size < sizeof(*hdr) ||
+	    memcmp(hdr->magic, JLT4013A_FW_MAGIC, sizeof(hdr->magic)) ||
+	    le16_to_cpu(hdr->version) != JLT4013A_FW_VERSION)
+		return -EINVAL;
+
+	/* Every command takes at least its fixed part, so bound the allocation */
+	count = le16_to_cpu(hdr->count);
+	if (!count ||
+	    count > (fw->size - sizeof(*hdr)) / sizeof(struct jlt4013a_fw_cmd))
+		return -EINVAL;
+
+	cmds = devm_kcalloc(dev, count, sizeof(*cmds), GFP_KERNEL);
+	if (!cmds)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		entry = (const void *)(fw->data + off);
+		if (fw->size - off < sizeof(*entry) ||
+		    fw->size - off - sizeof(*entry) < entry->len ||
+		    entry->len > ST7701S_MAX_PARAMS)
+			goto err_free;
+
+		cmds[i].cmd = entry->cmd;
+		cmds[i].len = entry->len;
+		cmds[i].delay_ms = le16_to_cpu(entry->delay_ms);
+		memcpy(cmds[i].data, entry->data, entry->len);
+
+		off += sizeof(*entry) + entry->len;
+	}
+
+	if (off != fw->size)
+		goto err_free;
+
+	seq->name = "firmware";
+	seq->cmds = cmds;
+	seq->len = count;
+	return 0;
+
+err_free:
+	devm_kfree(dev, cmds);
+	return -EINVAL;
+}
+
+/*
+ * The sequence is parsed once here and kept for every later bring-up. If it
+ * cannot be loaded the built-in one is used.
+ */
+static void jlt4013a_load_firmware(struct jlt4013a *ctx)
+{
+	struct device *dev = &ctx->spi->dev;
+	const struct firmware *fw;
+	const char *name;
+	int ret;
+
+	if (device_property_read_string(dev, "firmware-name", &name))
+		return;
+
+	ret = request_firmware(&fw, name, dev);
+	if (ret) {
+		dev_warn(dev,
+			 "Jinglitai JLT4013A: Failed to load %s, using built-in init sequence\n",
+			 name);
+		return;
+	}
+
+	ret = jlt4013a_parse_firmware(dev, fw, &ctx->fw_seq);
+	release_firmware(fw);
+	if (ret) {
+		dev_warn(dev,
+			 "Jinglitai JLT4013A: Invalid init sequence in %s, using built-in one\n",
+			 name);
+		return;
+	}
+
+	ctx->seq = &ctx->fw_seq;
+	ctx->seq_len = 1;
+
+	dev_info(dev, "Jinglitai JLT4013A: Loaded init sequence from %s, %u commands\n",
+		 name, ctx->fw_seq.len);
+}
+
+/*
+ * The panel can only flip its scan directions, which covers a rotation by
+ * 180 degrees. Other rotations are left to the display pipeline through the
+ * connector's panel orientation.
+ */
+static void jlt4013a_read_rotation(struct jlt4013a *ctx)
+{
+	struct device *dev = &ctx->spi->dev;
+	u32 rotation = 0;
+
+	ctx->orientation = DRM_MODE_PANEL_ORIENTATION_NORMAL;
+	device_property_read_u32(dev, "rotation", &rotation);
+
+	switch (rotation) {
+	case 0:
+		break;
+	case 90:
+		ctx->orientation = DRM_MODE_PANEL_ORIENTATION_RIGHT_UP;
+		break;
+	case 180:
+		ctx->flip = true;
+		break;
+	case 270:
+		ctx->orientation = DRM_MODE_PANEL_ORIENTATION_LEFT_UP;
+		break;
+	default:
+		dev_warn(dev, "Jinglitai JLT4013A: Invalid rotation %u\n",
+			 rotation);
+		break;
+	}
+}
+
+/*
+ * The number of RGB data lines wired up on the board. With 16 of them the
+ * display engine can scan out a 16 bpp framebuffer at half the bandwidth.
+ */
+static int jlt4013a_read_format(struct jlt4013a *ctx)
+{
+	struct device *dev = &ctx->spi->dev;
+	u32 bus_width = ctx->desc->bus_width;
+	unsigned int i;
+
+	device_property_read_u32(dev, "bus-width", &bus_width);
+
+	for (i = 0; i < ARRAY_SIZE(jlt4013a_formats); i++) {
+		if (jlt4013a_formats[i].bus_width == bus_width) {
+			ctx->format = &jlt4013a_formats[i];
+			return 0;
+		}
+	}
+
+	dev_err(dev, "Jinglitai JLT4013A: Unsupported bus width %u\n",
+		bus_width);
+	return -EINVAL;
+}
+
 static int jlt4013a_probe(struct spi_device *spi)
 {
 	int err;
@@ -468,6 +2982,10 @@ static int jlt4013a_probe(struct spi_device *spi)
 	ctx->spi = spi;
 	spi_set_drvdata(spi, ctx);
 
+	ctx->desc = device_get_match_data(dev);
+	if (!ctx->desc)
+		return -ENODEV;
+
 	ctx->supply = devm_regulator_get(dev, "power");
 	if (IS_ERR(ctx->supply)) {
 		dev_err(dev,
@@ -475,18 +2993,75 @@ static int jlt4013a_probe(struct spi_device *spi)
 		return PTR_ERR(ctx->supply);
 	}
 
+	ctx->supply_nb.notifier_call = jlt4013a_supply_event;
+	err = devm_regulator_register_notifier(ctx->supply, &ctx->supply_nb);
+	if (err)
+		return err;
+
 	ctx->reset = devm_gpiod_get(dev, "reset", GPIOD_OUT_LOW);
 	if (IS_ERR(ctx->reset)) {
 		dev_err(dev, "Jinglitai JLT4013A: Failed to get reset GPIO\n");
 		return PTR_ERR(ctx->reset);
 	}
 
-	ctx->dcx = devm_gpiod_get(dev, "dcx", GPIOD_OUT_LOW);
+	ctx->dcx = devm_gpiod_get_optional(dev, "dcx", GPIOD_OUT_LOW);
 	if (IS_ERR(ctx->dcx)) {
 		dev_err(dev, "Jinglitai JLT4013A: Failed to get dcx GPIO\n");
 		return PTR_ERR(ctx->dcx);
 	}
 
+	if (ctx->dcx) {
+		ctx->bus = ST7701S_BUS_DCX;
+	} else {
+		ctx->bus = spi_is_bpw_supported(spi, 9) ?
+				   ST7701S_BUS_9BIT :
+				   ST7701S_BUS_9BIT_PACKED;
+
+		ctx->pipe = devm_kzalloc(dev, sizeof(*ctx->pipe), GFP_KERNEL);
+		if (!ctx->pipe)
+			return -ENOMEM;
+		init_completion(&ctx->pipe->done);
+
+		dev_info(dev, "Jinglitai JLT4013A: Using 3-wire SPI%s\n",
+			 ctx->bus == ST7701S_BUS_9BIT_PACKED ?
+				 " with packed 9-bit words" :
+				 "");
+	}
+
+	ctx->timings = *ctx->desc->timings;
+	device_property_read_u32(dev, "jinglitai,power-on-delay-us",
+				 &ctx->timings.power_on);
+	device_property_read_u32(dev, "jinglitai,reset-assert-delay-us",
+				 &ctx->timings.reset_assert);
+	device_property_read_u32(dev, "jinglitai,reset-release-delay-us",
+				 &ctx->timings.reset_release);
+	device_property_read_u32(dev, "jinglitai,sleep-out-delay-us",
+				 &ctx->timings.sleep_out);
+	device_property_read_u32(dev, "jinglitai,sleep-in-delay-us",
+				 &ctx->timings.sleep_in);
+	device_property_read_u32(dev, "jinglitai,display-on-delay-us",
+				 &ctx->timings.display_on);
+
+	ctx->seq = ctx->desc->seq;
+	ctx->seq_len = ctx->desc->seq_len;
+	jlt4013a_load_firmware(ctx);
+
+	jlt4013a_read_rotation(ctx);
+	err = jlt4013a_read_format(ctx);
+	if (err)
+		return err;
+
+	err = jlt4013a_build_profile(ctx);
+	if (err)
+		return err;
+
+	mutex_init(&ctx->lock);
+	INIT_WORK(&ctx->bringup_work, jlt4013a_bringup_work);
+	init_completion(&ctx->bringup_done);
+	INIT_WORK(&ctx->cycle_work, jlt4013a_cycle_work);
+	INIT_DELAYED_WORK(&ctx->blank_work, jlt4013a_blank_work);
+	INIT_DELAYED_WORK(&ctx->esd_work, jlt4013a_esd_work);
+
 	drm_panel_init(&ctx->panel, dev, &jlt4013afuncs,
 		       DRM_MODE_CONNECTOR_DPI);
 
@@ -494,24 +3069,96 @@ static int jlt4013a_probe(struct spi_device *spi)
 	if (err)
 		return err;
 
+	st7701s_shadow_reset(ctx, ST7701S_BANK_UNKNOWN);
+
+	ctx->regmap = devm_regmap_init(dev, &jlt4013a_regmap_bus, ctx,
+				       &jlt4013a_regmap_config);
+	if (IS_ERR(ctx->regmap)) {
+		dev_err(dev, "Jinglitai JLT4013A: Failed to init regmap\n");
+		return PTR_ERR(ctx->regmap);
+	}
+
+	err = jlt4013a_adopt_boot_state(ctx);
+	if (err)
+		return err;
+
+	regcache_cache_only(ctx->regmap, ctx->state == JLT4013A_OFF);
+
+	/*
+	 * This covers the panel only. The SPI core resumes the controller
+	 * around each message by itself, so the controller can suspend while
+	 * the panel is up but the bus is idle.
+	 */
+	pm_runtime_set_autosuspend_delay(dev, JLT4013A_AUTOSUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(dev);
+	if (ctx->state != JLT4013A_OFF)
+		pm_runtime_set_active(dev);
+	pm_runtime_enable(dev);
+
+	/* An adopted panel counts as brought up until the first unprepare */
+	if (async_prepare || ctx->handoff) {
+		err = jlt4013a_start_bring_up(ctx);
+		if (err) {
+			pm_runtime_disable(dev);
+			pm_runtime_dont_use_autosuspend(dev);
+			mutex_lock(&ctx->lock);
+			jlt4013a_power_off(ctx);
+			mutex_unlock(&ctx->lock);
+			return err;
+		}
+	}
+
 	drm_panel_add(&ctx->panel);
 
+	jlt4013a_debugfs_init(ctx);
+
 	return 0;
 }
 
+static void jlt4013a_teardown(struct jlt4013a *ctx)
+{
+	struct device *dev = &ctx->spi->dev;
+
+	atomic_set(&ctx->cycles, 0);
+	cancel_work_sync(&ctx->cycle_work);
+
+	cancel_delayed_work_sync(&ctx->esd_work);
+	cancel_delayed_work_sync(&ctx->blank_work);
+	ctx->blank_pending = false;
+	if (ctx->sleep_pending)
+		pm_runtime_put_noidle(dev);
+	ctx->sleep_pending = false;
+
+	jlt4013a_wait_bring_up(ctx);
+	if (ctx->bringup_queued)
+		pm_runtime_put_noidle(dev);
+	ctx->bringup_queued = false;
+
+	pm_runtime_disable(dev);
+	pm_runtime_dont_use_autosuspend(dev);
+	mutex_lock(&ctx->lock);
+	jlt4013a_power_off(ctx);
+	mutex_unlock(&ctx->lock);
+	pm_runtime_set_suspended(dev);
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6,0,0)
 static void jlt4013a_remove(struct spi_device *spi)
 {
 	struct jlt4013a *ctx = spi_get_drvdata(spi);
 
+	debugfs_remove_recursive(ctx->debugfs);
 	drm_panel_remove(&(ctx->panel));
+	jlt4013a_teardown(ctx);
 }
 #else
 static int jlt4013a_remove(struct spi_device *spi)
 {
 	struct jlt4013a *ctx = spi_get_drvdata(spi);
 
+	debugfs_remove_recursive(ctx->debugfs);
 	drm_panel_remove(&(ctx->panel));
+	jlt4013a_teardown(ctx);
 	return 0;
 }
 #endif
@@ -522,10 +3169,15 @@ static struct spi_driver jlt4013a_driver = {
 	.driver		= {
 		.name	= "jlt4013a",
 		.of_match_table = jlt4013a_of_match,
+		.pm	= &jlt4013a_pm_ops,
 	},
 };
 module_spi_driver(jlt4013a_driver);
 
+#ifdef JLT4013A_KUNIT_TEST
+#include "panel-jinglitai-jlt4013a-test.c"
+#endif
+
 MODULE_AUTHOR("Rui Oliveira <ruimail24@gmail.com>");
 MODULE_AUTHOR("Oleg Belousov <www.strijar.ru>");
 MODULE_DESCRIPTION("Driver for the Jinglitai JLT4013A LCD Panel");